@@ -0,0 +1,44 @@
+#ifndef LASER_MERGER2_CLOUD_VIEW_HPP_
+#define LASER_MERGER2_CLOUD_VIEW_HPP_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rclcpp/serialized_message.hpp"
+#include "sensor_msgs/msg/point_cloud2.hpp"
+#include "std_msgs/msg/header.hpp"
+
+// Layout of a PointCloud2 whose point data is read in place, either from a
+// deserialized message or straight from its CDR buffer. The view does not own
+// the data, the message or serialized buffer must outlive it.
+struct CloudView
+{
+  std_msgs::msg::Header header;
+  uint32_t height = 0;
+  uint32_t width = 0;
+  uint32_t point_step = 0;
+  uint32_t row_step = 0;
+  bool is_bigendian = false;
+  std::vector<sensor_msgs::msg::PointField> fields;
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;
+
+  static CloudView fromMessage(const sensor_msgs::msg::PointCloud2 &cloud);
+
+  // Decode the header and field layout of a serialized PointCloud2, false when the buffer is malformed
+  bool fromCdr(const rclcpp::SerializedMessage &serialized);
+
+  // nullptr when the cloud has no such field or it does not fit inside a point
+  const sensor_msgs::msg::PointField *field(const std::string &name) const;
+
+  size_t size() const { return static_cast<size_t>(width) * height; }
+  bool valid() const;
+};
+
+// Read one scalar of the given PointField datatype as float
+float readCloudScalar(const uint8_t *ptr, uint8_t datatype);
+// Same in double, FLOAT64 values such as absolute times keep their precision
+double readCloudDouble(const uint8_t *ptr, uint8_t datatype);
+
+#endif
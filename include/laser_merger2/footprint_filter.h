@@ -0,0 +1,55 @@
+#ifndef LASER_MERGER2_FOOTPRINT_FILTER_HPP_
+#define LASER_MERGER2_FOOTPRINT_FILTER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "laser_merger2/merged_cloud.h"
+#include "laser_merger2/worker_pool.h"
+
+// Removes the points falling on the robot itself: the union of a footprint polygon and a set of boxes,
+// given in the target frame and extruded over every height.
+// When every edge is axis aligned the footprint is rasterized once into a lookup grid and each point costs
+// one cell read. Other polygons use the even-odd crossing test, run edge by edge over blocks of points so
+// the inner loop is branch free and vectorized by the compiler at -O3 (set for this file in CMakeLists.txt).
+class FootprintFilter
+{
+  public:
+    // polygon is x0, y0, x1, y1, ... and boxes are min_x, min_y, max_x, max_y, ...
+    // resolution(m) is the cell size of the lookup grid of rectilinear footprints
+    FootprintFilter(const std::vector<double> &polygon, const std::vector<double> &boxes, double resolution);
+
+    bool empty() const { return empty_; }
+    bool rasterized() const { return rasterized_; }
+
+    // Drop the points inside the footprint, the others keep their order
+    void filter(MergedCloud &points, WorkerPool &workers);
+
+  private:
+    bool insideShape(float x, float y) const;
+    void classify(const MergedCloud &points, size_t begin, size_t end);
+
+    bool empty_ = true;
+    bool rasterized_ = false;
+
+    // polygon edges, horizontal ones never cross a scanline and are left out
+    std::vector<float> edge_x_;
+    std::vector<float> edge_y0_;
+    std::vector<float> edge_y1_;
+    std::vector<float> edge_slope_;     // dx / dy
+    std::vector<float> boxes_;
+
+    // bounding box, nothing outside it is tested further
+    float min_x_ = 0.0f, min_y_ = 0.0f, max_x_ = 0.0f, max_y_ = 0.0f;
+
+    // lookup grid over the bounding box, row major
+    float inv_resolution_ = 0.0f;
+    int cols_ = 0;
+    int rows_ = 0;
+    std::vector<uint8_t> grid_;
+
+    std::vector<uint8_t> inside_;
+};
+
+#endif
@@ -3,7 +3,10 @@
 #define LASER_MERGER2_NODE_HPP_
 
 #include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <regex>
 #include <string>
 #include <thread>
 
@@ -18,8 +21,19 @@
 #include "rclcpp/rclcpp.hpp"
 #include "sensor_msgs/msg/laser_scan.hpp"
 #include "sensor_msgs/msg/point_cloud2.hpp"
+#include "geometry_msgs/msg/transform_stamped.hpp"
+#include "geometry_msgs/msg/twist_stamped.hpp"
+#include "diagnostic_msgs/msg/diagnostic_array.hpp"
+#include "diagnostic_msgs/msg/diagnostic_status.hpp"
 
+#include "laser_merger2/cloud_view.h"
+#include "laser_merger2/footprint_filter.h"
+#include "laser_merger2/merged_cloud.h"
+#include "laser_merger2/realtime.h"
+#include "laser_merger2/sync_matcher.h"
 #include "laser_merger2/visibility_control.h"
+#include "laser_merger2/voxel_grid.h"
+#include "laser_merger2/worker_pool.h"
 
 #include <eigen3/Eigen/Dense>
 
@@ -29,51 +43,268 @@
 
 using namespace std::chrono_literals;
 
+// Per-sensor lookup table used to project LaserScan beams straight into the merged scan
 typedef struct{
-	float x;
-  float y;
-  float z; 
-  std::optional<float> intensity; // Optional intensity field
-} SCAN_POINT_t;
+  float angle_min;
+  float angle_increment;
+  size_t size;
+  double dx;                        // sensor offset in target frame
+  double dy;
+  double yaw;
+  bool centered;                    // sensor origin coincides with target frame origin
+  std::vector<float> cos_beam;      // beam direction in target frame
+  std::vector<float> sin_beam;
+  std::vector<int32_t> bin;         // output bin of each beam (centered sensors only, -1 when out of view)
+} SCAN_TABLE_t;
+
+// Buffered PointCloud2 input, read in place from whichever of the two messages is set
+typedef struct{
+  sensor_msgs::msg::PointCloud2::SharedPtr msg;
+  std::shared_ptr<rclcpp::SerializedMessage> serialized;
+  CloudView view;
+} CLOUD_INPUT_t;
+
+// Planar motion of the target frame between the capture of a message and the merge reference time,
+// evaluated at the first and last beam and interpolated in between
+typedef struct{
+  double x[2];
+  double y[2];
+  double yaw[2];
+} SENSOR_MOTION_t;
+
+// One buffered input message, either a LaserScan or a PointCloud2
+typedef struct{
+  size_t sensor;                    // index into sensors_
+  int64_t stamp;                    // header stamp in nanoseconds
+  sensor_msgs::msg::LaserScan::SharedPtr scan;
+  CLOUD_INPUT_t cloud;
+  geometry_msgs::msg::TransformStamped transform;   // sensor to target frame
+  bool has_transform;
+  SENSOR_MOTION_t motion;
+  bool has_motion;                  // motion compensation applies to this input
+} SENSOR_INPUT_t;
+
+// How the per-point time field of a PointCloud2 input relates to the header stamp
+enum class TimeReference
+{
+    Auto,       // values beyond absolute_time_threshold are absolute, the others relative
+    Relative,   // time after the header stamp
+    Absolute    // time since the epoch, like the header stamp
+};
+
+// Per-sensor settings, resolved once at startup from the sensors.<topic> parameter namespace.
+// The scalars read by the conversion kernels come first so they share a cache line.
+typedef struct{
+  double range_min;                     // only ever tighten the limits the messages carry
+  double range_max;
+  float intensity_scale;                // brings the intensities of mixed sensor models to one scale
+  bool zero_intensity;                  // report 0 instead of the sensor intensity, never drops the field
+  int decimation;                       // keep every Nth beam
+  double angular_resolution;            // rad, keep the closest return of each group of beams this wide
+  int row_stride;                       // organized clouds: keep every Nth row and column
+  int col_stride;
+  int priority;                         // higher priority sensors come first in the merged buffer
+  int qos_depth;                        // subscription depth
+  TimeReference time_reference;         // PointCloud2 only
+  std::vector<double> exclude_angles;   // [start, end] pairs(rad) in the sensor frame, LaserScan only
+} SENSOR_CONFIG_t;
+
+// Beams of one LaserScan layout left outside the exclusion windows, one bit per beam
+typedef struct{
+  float angle_min;
+  float angle_increment;
+  size_t size;
+  size_t group;                     // beams pooled into one sample for angular_resolution, 1 keeps them all
+  std::vector<uint64_t> bits;
+} BEAM_MASK_t;
+
+// State of one input topic
+typedef struct{
+  std::string topic;
+  bool is_scan;
+  uint8_t id;                       // value of the sensor_id point field
+  std::string frame_id;             // last frame seen on the topic, published in the id table
+  std::deque<SENSOR_INPUT_t> queue; // ordered by stamp, bounded by sync_depth
+  SCAN_TABLE_t table;
+  SENSOR_INPUT_t last;              // last merged input, reused while younger than sensor_max_age
+  bool has_last;
+  MergedCloud points;               // last input converted to the target frame, point times relative to its stamp
+  bool converted;
+  int64_t reference;                // merge stamp the converted points are motion compensated to
+  SENSOR_CONFIG_t config;
+  BEAM_MASK_t mask;                 // built from config for the beam layout last seen on the topic
+  std::vector<uint64_t> beams;      // beams of the current scan left to convert
+  std::vector<uint8_t> gate;        // range gate of the current scan, one byte per beam
+  rclcpp::SubscriptionBase::SharedPtr subscription;   // null once the topic is removed, the slot is kept for a later re-add
+  bool stalled;                     // left out of approximate matching until it delivers again
+  ArrivalMonitor arrivals;          // receive times on the steady clock, tell a stopped sensor from a slow one
+} SENSOR_t;
+
+// Box in the target frame the converted points must fall in, bounds included.
+// Unset bounds are +-FLT_MAX so the same test also rejects NaN and infinite points.
+typedef struct{
+  float min[3];
+  float max[3];
+  bool enabled;     // at least one bound is set
+} CROP_t;
+
+// Overload controller state, the merge cycle time is compared to the 1 / rate budget.
+// Levels: 0 nominal, 1 beams and cloud points decimated by 2, 2 decimated by 4 and voxel leaf doubled,
+// 3 cloud output skipped on top of it
+typedef struct{
+  int level;
+  double utilization;       // smoothed cycle time / budget
+  int high_cycles;          // consecutive cycles above overload_high
+  int low_cycles;           // consecutive cycles below overload_low
+  int report_age;           // cycles since the last report
+} LOAD_t;
+
+// Merge cycle period statistics over the current report window
+typedef struct{
+  std::chrono::steady_clock::time_point last;
+  bool has_last;
+  int count;
+  double sum;               // s
+  double sum_sq;
+  double max_deviation;     // largest |period - 1 / rate|
+} JITTER_t;
+
+// Outputs that currently have at least one (intra- or inter-process) subscriber
+typedef struct{
+  bool cloud;
+  bool scan;
+} OUTPUT_DEMAND_t;
+
+// A cloud and scan pair published in one frame
+typedef struct{
+  std::string frame_id;
+  std::shared_ptr<rclcpp::Publisher<MergedCloudAdapter>> cloud_pub;
+  std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::LaserScan>> scan_pub;
+  OUTPUT_DEMAND_t demand;
+} MERGE_OUTPUT_t;
+
+// One set of outputs merged from a subset of the inputs.
+// Every group shares the subscriptions, the TF buffer, the per-sensor conversion cache and the worker pool:
+// inputs are converted once to target_frame_ and the merged buffer is moved to each output frame by one rigid transform.
+typedef struct{
+  std::string name;                 // empty for the primary group
+  std::vector<bool> inputs;         // per sensor
+  std::vector<MERGE_OUTPUT_t> outputs;  // outputs[0] is in the group target frame, then the output_frames
+} MERGE_GROUP_t;
 
 class laser_merger2 : public rclcpp::Node
 {
   public:
-    laser_merger2();
+    explicit laser_merger2(const rclcpp::NodeOptions &options = rclcpp::NodeOptions());
     ~laser_merger2();
 
   private:
-    void scanCallback(const sensor_msgs::msg::LaserScan::SharedPtr scan);
-    void pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr cloud);
-    std::vector<SCAN_POINT_t> scantoPointXYZ(const sensor_msgs::msg::LaserScan::SharedPtr scan);
-    std::vector<SCAN_POINT_t> pointCloudtoPointXYZ(const sensor_msgs::msg::PointCloud2::SharedPtr cloud);
+    void scanCallback(const sensor_msgs::msg::LaserScan::SharedPtr scan, size_t sensor);
+    void pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr cloud, size_t sensor);
+    void serializedCloudCallback(std::shared_ptr<rclcpp::SerializedMessage> serialized, size_t sensor);
+    // index of the topic's slot, sensors_.size() when it is refused
+    size_t addSensor(const std::string &topic, bool is_scan);
+    void subscribeSensor(size_t sensor);
+    void removeSensor(size_t sensor);
+    rcl_interfaces::msg::SetParametersResult inputsCallback(const std::vector<rclcpp::Parameter> &parameters);
+    void updateInputs();
+    void discoveryLoop();
+    void discoverTopics();
+    SENSOR_CONFIG_t loadSensorConfig(const std::string &topic);
+    void updateBeamMask(const sensor_msgs::msg::LaserScan &scan, SENSOR_t &sensor);
+    void selectBeams(const sensor_msgs::msg::LaserScan &scan, SENSOR_t &sensor);
+    const std::string &inputFrame(const SENSOR_INPUT_t &input);
+    void resolveInput(SENSOR_INPUT_t &&input);
+    bool resolveLatest(SENSOR_INPUT_t &input);
+    void enqueueInput(SENSOR_INPUT_t &&input);
+    void twistCallback(const geometry_msgs::msg::TwistStamped::SharedPtr twist);
+    bool targetMotion(int64_t stamp, double &x, double &y, double &yaw);
+    void compensateMotion(SENSOR_INPUT_t &input);
+    void publishSensorIds();
+    std::vector<size_t> activeSensors(const std::vector<SENSOR_INPUT_t> &inputs);
+    bool matchQueues(bool partial, std::vector<size_t> &matched, std::vector<size_t> &picks);
+    void updateStalled();
+    bool frameReady();
+    std::vector<SENSOR_INPUT_t> selectInputs(bool partial);
+    bool waitForMerge();
+    void publishMergeStatus(const std::vector<SENSOR_INPUT_t> &inputs);
+    void scantoPointXYZ(const SENSOR_INPUT_t &input, MergedCloud &points);
+    void pointCloudtoPointXYZ(const SENSOR_INPUT_t &input, MergedCloud &points);
+    bool insideCrop(float x, float y, float z) const;
     Eigen::Matrix4d Rotate3Z(double rad);
     Eigen::Matrix4d ConvertTransMatrix(geometry_msgs::msg::TransformStamped trans);
+    Eigen::Matrix4d motionAt(const SENSOR_MOTION_t &motion, double ratio);
     uint32_t rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b);
-    void ConvertPointCloud2(std::vector<SCAN_POINT_t> points);
-    void ConvertLaserScan(std::vector<SCAN_POINT_t> points);
+    void convertSensor(SENSOR_t &sensor);
+    bool rebaseCache(SENSOR_t &sensor);
+    bool transformPoints(const MergedCloud &points, MergedCloud &out, const std::string &frame_id);
+    void mergeGroup(MERGE_GROUP_t &group, const std::vector<size_t> &active, int64_t stamp);
+    void publishOutput(MergedCloud &points, const MERGE_OUTPUT_t &output);
+    void ConvertPointCloud2(MergedCloud &points, const MERGE_OUTPUT_t &output);
+    void ConvertLaserScan(const MergedCloud &points, const MERGE_OUTPUT_t &output);
+    void binPoints(const MergedCloud &points, size_t begin, size_t end, float *ranges, float *intensities, size_t ranges_size);
+    sensor_msgs::msg::LaserScan::UniquePtr createLaserScan(bool has_intensity, const std::string &frame_id);
+    int scanIndex(double angle, size_t ranges_size);
+    void updateScanTable(const SENSOR_INPUT_t &input, SCAN_TABLE_t &table);
+    void projectScansDirect(const std::vector<SENSOR_INPUT_t> &inputs, const MERGE_OUTPUT_t &output);
+    MERGE_OUTPUT_t createOutput(const std::string &prefix, const std::string &frame_id, bool extra);
+    void updateOutputDemand();
     void laser_merge();
+    void mergeCycle(bool partial);
+    void prefaultMergeBuffers();
+    void mergeOnce(bool partial);
+    void updateLoad(double cycle_time);
+    void publishLoad(double cycle_time);
+    void updateJitter();
 
     std::mutex nodeMutex_;
+    std::condition_variable inputCv_;           // signalled on every queued input
+    bool frameOpen_ = false;                    // a message arrived since the last merge
+    std::chrono::steady_clock::time_point frameStart_;
 
     std::unique_ptr<tf2_ros::Buffer> tf2_;
     std::unique_ptr<tf2_ros::TransformListener> tf2_listener_;
 
-    std::vector<rclcpp::Subscription<sensor_msgs::msg::LaserScan>::SharedPtr> laser_sub;
-    std::vector<rclcpp::Subscription<sensor_msgs::msg::PointCloud2>::SharedPtr> point_cloud_sub;
+    // requested inputs of every group, set by the parameters and applied by updateInputs between merges
+    std::vector<std::vector<std::string>> groupScanTopics_;
+    std::vector<std::vector<std::string>> groupCloudTopics_;
+    bool inputsChanged_ = false;
+    // topics found by the discovery patterns, merged by the primary group next to scan_topics and point_cloud_topics
+    std::unique_ptr<std::regex> discoverScan_;
+    std::unique_ptr<std::regex> discoverCloud_;
+    std::vector<std::string> discoveredScanTopics_;
+    std::vector<std::string> discoveredCloudTopics_;
+    std::thread discovery_thread_;
+    rclcpp::node_interfaces::OnSetParametersCallbackHandle::SharedPtr inputsHandle_;
 
-    std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::PointCloud2>> pclPub_;
-    std::shared_ptr<rclcpp::Publisher<sensor_msgs::msg::LaserScan>> scanPub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticStatus>::SharedPtr sensorIdPub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticArray>::SharedPtr mergeStatusPub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticStatus>::SharedPtr loadPub_;
+    rclcpp::Publisher<diagnostic_msgs::msg::DiagnosticStatus>::SharedPtr jitterPub_;
 
-    std::map<std::string, sensor_msgs::msg::LaserScan::SharedPtr> scanBuffer;
-    std::map<std::string, sensor_msgs::msg::PointCloud2::SharedPtr> pointCloudBuffer;
+    rclcpp::Event::SharedPtr graphEvent_;
+    std::vector<MERGE_GROUP_t> groups_;     // groups_[0] is the primary group
+    int demandAge_ = 0;
+
+    std::vector<SENSOR_t> sensors_;
+
+    rclcpp::Subscription<geometry_msgs::msg::TwistStamped>::SharedPtr twist_sub;
+    geometry_msgs::msg::Twist latestTwist_;
 
     std::thread subscription_listener_thread_;
     std::atomic_bool alive_{true};
 
     laser_geometry::LaserProjection projector_;
 
-    rclcpp::TimerBase::SharedPtr timer_;
+    std::unique_ptr<WorkerPool> workers_;
+    std::unique_ptr<VoxelGrid> voxelGrid_;      // optional downsampling of the cloud output
+    std::unique_ptr<FootprintFilter> footprint_;  // optional self filter
+    std::vector<std::vector<float>> partialRanges_;        // per-worker private scan bins
+    std::vector<std::vector<float>> partialIntensities_;
+    std::vector<float> scratchX_, scratchY_, scratchZ_;     // output columns of in place transforms
+
+    rclcpp::TimerBase::SharedPtr timer_;          // drives the merge with merge_trigger 'timer'
+    rclcpp::CallbackGroup::SharedPtr mergeGroup_;
     rclcpp::Time laserTime;
 
     // ROS Parameters
@@ -85,6 +316,7 @@ class laser_merger2 : public rclcpp::Node
     double rate_;
     int input_queue_size_;
     int subscription_count;
+    int worker_threads_;
 
     double max_range;
     double min_range;
@@ -94,6 +326,30 @@ class laser_merger2 : public rclcpp::Node
     double angle_increment;
     double inf_epsilon;
     bool use_inf;
+    bool serialized_clouds_;
+    bool publish_point_time_;
+    bool publish_sensor_id_;
+    double sensor_max_age_;
+    double merge_deadline_;
+    bool approximate_sync_;
+    int sync_depth_;
+    int64_t sync_window_;             // nanoseconds
+    bool stamped_tf_;
+    std::string motion_compensation_;
+    std::string fixed_frame_;
+    CROP_t crop_;
+    double voxel_leaf_size_;
+    bool overload_control_;
+    double overload_high_;
+    double overload_low_;
+    LOAD_t load_{0, 0.0, 0, 0, 0};
+    size_t loadStride_ = 1;           // extra beam/point decimation of the current load level
+    int realtime_priority_;
+    std::vector<int64_t> cpu_affinity_;
+    bool lock_memory_;
+    int prefault_points_;
+    bool prefaulted_ = false;
+    JITTER_t jitter_{};
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef LASER_MERGER2_MERGED_CLOUD_HPP_
+#define LASER_MERGER2_MERGED_CLOUD_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "rclcpp/type_adapter.hpp"
+#include "sensor_msgs/msg/point_cloud2.hpp"
+#include "std_msgs/msg/header.hpp"
+
+// Structure-of-arrays buffer holding the merged points in the target frame.
+// x/y/z/intensity have size() entries, intensity is only meaningful when has_intensity is set.
+// t holds the capture time of each point as an offset(s) from header.stamp and is only filled when has_time is set.
+// sensor_id holds the id of the input each point comes from and is only filled when has_sensor_id is set.
+struct MergedCloud
+{
+  std_msgs::msg::Header header;
+  bool has_intensity = true;     // cleared as soon as one merged input carries no intensity
+  bool has_time = false;
+  bool has_sensor_id = false;
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> intensity;
+  std::vector<float> t;
+  std::vector<uint8_t> sensor_id;
+
+  size_t size() const { return x.size(); }
+  bool empty() const { return x.empty(); }
+
+  void clear()
+  {
+    has_intensity = true;
+    has_time = false;
+    has_sensor_id = false;
+    x.clear();
+    y.clear();
+    z.clear();
+    intensity.clear();
+    t.clear();
+    sensor_id.clear();
+  }
+
+  void reserve(size_t count)
+  {
+    x.reserve(count);
+    y.reserve(count);
+    z.reserve(count);
+    intensity.reserve(count);
+    if (has_time)
+      t.reserve(count);
+    if (has_sensor_id)
+      sensor_id.reserve(count);
+  }
+
+  // Append another buffer, shifting its point times by time_shift(s) to this buffer's stamp
+  void append(const MergedCloud &other, float time_shift)
+  {
+    has_intensity &= other.has_intensity;
+    x.insert(x.end(), other.x.begin(), other.x.end());
+    y.insert(y.end(), other.y.begin(), other.y.end());
+    z.insert(z.end(), other.z.begin(), other.z.end());
+    intensity.insert(intensity.end(), other.intensity.begin(), other.intensity.end());
+    if (has_time)
+    {
+      for (float other_t : other.t)
+        t.push_back(other_t + time_shift);
+    }
+    if (has_sensor_id)
+      sensor_id.insert(sensor_id.end(), other.sensor_id.begin(), other.sensor_id.end());
+  }
+
+  // Set every filled column to count entries, conversion kernels grow the buffer,
+  // write each candidate point at the current end and shrink back to the points they kept
+  void resize(size_t count)
+  {
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    intensity.resize(count);
+    if (has_time)
+      t.resize(count);
+    if (has_sensor_id)
+      sensor_id.resize(count);
+  }
+
+  void push_back(float px, float py, float pz, float pi)
+  {
+    x.push_back(px);
+    y.push_back(py);
+    z.push_back(pz);
+    intensity.push_back(pi);
+  }
+};
+
+// REP-2007 adapter: intra-process subscribers receive the MergedCloud as is,
+// the PointCloud2 encoding is only produced when an inter-process subscriber exists.
+namespace rclcpp
+{
+template<>
+struct TypeAdapter<MergedCloud, sensor_msgs::msg::PointCloud2>
+{
+  using is_specialized = std::true_type;
+  using custom_type = MergedCloud;
+  using ros_message_type = sensor_msgs::msg::PointCloud2;
+
+  static void convert_to_ros_message(const custom_type &source, ros_message_type &destination);
+  static void convert_to_custom(const ros_message_type &source, custom_type &destination);
+};
+}  // namespace rclcpp
+
+using MergedCloudAdapter = rclcpp::TypeAdapter<MergedCloud, sensor_msgs::msg::PointCloud2>;
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef LASER_MERGER2_REALTIME_HPP_
+#define LASER_MERGER2_REALTIME_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Give the calling thread SCHED_FIFO at priority (0 keeps the default policy) and pin it to cpus (empty keeps every CPU).
+// Returns false with the reason in error when the system refuses, typically without CAP_SYS_NICE or rtprio limits.
+bool configureThread(int priority, const std::vector<int64_t> &cpus, std::string &error);
+
+// Lock every current and future page of the process and keep freed heap memory mapped,
+// so buffers that grew once are never faulted in or returned to the system again.
+bool lockMemory(std::string &error);
+
+// Touch size bytes of the calling thread's stack so its pages are resident before the first cycle
+void prefaultStack(size_t size);
+
+// Grow the calling thread's heap by size touched bytes and free them again. After lockMemory the pages stay
+// mapped and locked, so later allocations up to that size do not fault
+void prefaultHeap(size_t size);
+
+#endif
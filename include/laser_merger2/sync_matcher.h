@@ -0,0 +1,43 @@
+#ifndef LASER_MERGER2_SYNC_MATCHER_HPP_
+#define LASER_MERGER2_SYNC_MATCHER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Pick one stamp per sensor so that the spread (newest - oldest) of the set is minimal.
+// stamps[s] holds the queued stamps of sensor s in ascending order (nanoseconds).
+// On success picks[s] is the chosen index into stamps[s] and the spread is at most window.
+// Sweeps the queues like a k-way merge over a min-heap of the heads: at most sensors x depth steps of
+// O(log sensors) each, without the per-arity template expansion of message_filters::ApproximateTime.
+bool matchTightestSet(const std::vector<std::vector<int64_t>> &stamps, int64_t window, std::vector<size_t> &picks);
+
+// Arrival times of one input stream (nanoseconds, any monotonic clock), tells a sensor that stopped publishing
+// from one that is only slower than the others.
+class ArrivalMonitor
+{
+  public:
+    // a stream silent for more than this many of its periods, plus the sync window, has stopped
+    static constexpr int stall_periods = 3;
+    // and one whose period is still unknown is given at least this long (ns), a slow sensor
+    // subscribed next to fast ones has not sent twice yet
+    static constexpr int64_t startup_grace = 1000000000;
+
+    // start watching at now, e.g. when the subscription is created, forgets the period
+    void reset(int64_t now);
+    void arrived(int64_t now);
+
+    // smoothed time between two messages, 0 until two arrived
+    int64_t period() const { return period_; }
+
+    // A stream whose period is still unknown is measured against fallback_period, the slowest known one,
+    // and startup_grace, and never stalls while that is 0 too.
+    bool stalled(int64_t now, int64_t fallback_period, int64_t window) const;
+
+  private:
+    int64_t last_ = 0;
+    int64_t period_ = 0;
+    bool has_last_ = false;
+};
+
+#endif
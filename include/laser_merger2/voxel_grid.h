@@ -0,0 +1,71 @@
+#ifndef LASER_MERGER2_VOXEL_GRID_HPP_
+#define LASER_MERGER2_VOXEL_GRID_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "laser_merger2/merged_cloud.h"
+#include "laser_merger2/worker_pool.h"
+
+// Hash based voxel grid downsampling of a MergedCloud, keeping one point per occupied leaf.
+// Points are keyed by their integer leaf coordinates and each worker owns the leaves whose hash falls
+// in its share. Key, hash and owner are computed once per point, a counting sort then hands every worker
+// the indices it owns in merge order, and workers fill private open-addressing tables without locks.
+// Tables are cleared by bumping a generation counter instead of a memset and only grow, so after the
+// first few cycles a merge allocates nothing.
+class VoxelGrid
+{
+  public:
+    enum class Policy
+    {
+        Centroid,   // average of the points in the leaf, sensor_id of the first one
+        First       // first point of the leaf in merge order
+    };
+
+    VoxelGrid(float leaf_size, Policy policy);
+
+    void setLeafSize(float leaf_size) { inv_leaf_ = 1.0f / leaf_size; }
+
+    // Replace points by its downsampled version, non-finite points and points beyond the key range are dropped
+    void filter(MergedCloud &points, WorkerPool &workers);
+
+    // Size and touch every buffer for clouds of up to points points, before the first filter
+    void reserve(size_t points, size_t workers);
+
+  private:
+    // a probe touches one slot and a hit one leaf, each a single cache line
+    typedef struct{
+        uint64_t key;
+        uint32_t generation;    // slot is empty unless it matches current
+        uint32_t cell;          // leaf index of the slot
+    } SLOT_t;
+
+    typedef struct{
+        double x, y, z, intensity, t;
+        uint32_t count;
+    } SUM_t;
+
+    typedef struct{
+        std::vector<SLOT_t> slots;          // open addressing
+        uint32_t current = 0;
+        // one entry per leaf
+        std::vector<uint32_t> first;
+        std::vector<SUM_t> sums;
+    } TABLE_t;
+
+    void bin(const MergedCloud &points, TABLE_t &table, const uint32_t *owned, size_t count);
+    void emit(const MergedCloud &points, const TABLE_t &table, size_t offset, MergedCloud &out) const;
+
+    float inv_leaf_;
+    Policy policy_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint64_t> hashes_;
+    std::vector<uint32_t> owners_;          // owning worker, workers for dropped points
+    std::vector<size_t> counts_;            // per slice and owner, then the scatter offsets
+    std::vector<uint32_t> order_;           // point indices grouped by owner
+    std::vector<TABLE_t> tables_;
+    MergedCloud out_;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef LASER_MERGER2_WORKER_POOL_HPP_
+#define LASER_MERGER2_WORKER_POOL_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads used to split the merge stages into contiguous chunks.
+// The calling thread always takes part as worker 0, so a pool of size 1 runs inline.
+class WorkerPool
+{
+  public:
+    typedef std::function<void(size_t begin, size_t end, size_t worker)> Task;
+    typedef std::function<void(size_t worker)> Setup;
+
+    // setup runs first on every spawned thread, e.g. to set its scheduling
+    explicit WorkerPool(size_t workers, const Setup &setup = nullptr);
+    ~WorkerPool();
+
+    size_t size() const { return threads_.size() + 1; }
+
+    // Split [0, count) into size() chunks and block until every chunk is processed
+    void parallelFor(size_t count, const Task &task);
+
+  private:
+    void run(size_t worker);
+
+    std::vector<std::thread> threads_;
+    std::mutex callMutex_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const Task *task_ = nullptr;
+    size_t count_ = 0;
+    size_t generation_ = 0;
+    size_t pending_ = 0;
+    bool stop_ = false;
+};
+
+#endif
@@ -2,6 +2,7 @@ import os
 from ament_index_python.packages import get_package_share_directory
 from launch import LaunchDescription
 from launch.actions import DeclareLaunchArgument
+from launch.actions import OpaqueFunction
 from launch_ros.actions import Node
 from launch.substitutions import LaunchConfiguration
 from launch.actions import IncludeLaunchDescription
@@ -9,7 +10,14 @@ from launch.launch_description_sources import PythonLaunchDescriptionSource
 from launch.substitutions import ThisLaunchFileDir
 
 
-def generate_launch_description():
+# Parameters whose default, an empty array or an unbounded height, cannot be given as a launch argument value
+# (see the topic arrays below). They are only passed to the node when set, e.g. footprint:="[0.5, 0.3, -0.5, 0.3, -0.5, -0.3]".
+# Give every value of a double array with a decimal point, [1, 2, 0] would be read as integers.
+optional_parameters = ['crop_box_min', 'crop_box_max', 'min_height', 'max_height', 'footprint', 'footprint_boxes',
+                       'cpu_affinity', 'merge_groups', 'output_frames']
+
+
+def launch_setup(context, *args, **kwargs):
     target_frame = LaunchConfiguration('target_frame', default='base_link')
     # We set the topic arrays to a default value of an array containing an empty string, because
     # ROS2 does not yet allow empty sequences for both launch arguments (cf https://github.com/ros2/launch_ros/blob/humble/launch_ros/launch_ros/utilities/evaluate_parameters.py#L50)
@@ -18,8 +26,13 @@ def generate_launch_description():
     scan_topics = LaunchConfiguration('scan_topics', default="['']")
     point_cloud_topics = LaunchConfiguration('point_cloud_topics', default="['']")
     transform_tolerance = LaunchConfiguration('transform_tolerance', default=0.1)
+    tf_lookup = LaunchConfiguration('tf_lookup', default='stamped')
+    motion_compensation = LaunchConfiguration('motion_compensation', default='none')
+    fixed_frame = LaunchConfiguration('fixed_frame', default='odom')
+    twist_topic = LaunchConfiguration('twist_topic', default='twist')
     rate = LaunchConfiguration('rate', default=30.0)
     queue_size = LaunchConfiguration('queue_size', default=10)
+    worker_threads = LaunchConfiguration('worker_threads', default=1)
     max_range = LaunchConfiguration('max_range', default=30.0)
     min_range = LaunchConfiguration('min_range', default=0.06)
     max_angle = LaunchConfiguration('max_angle', default=3.141592654)
@@ -28,11 +41,39 @@ def generate_launch_description():
     angle_increment = LaunchConfiguration('angle_increment', default=0.02)
     inf_epsilon = LaunchConfiguration('inf_epsilon', default=1.0)
     use_inf = LaunchConfiguration('use_inf', default=True)
+    serialized_clouds = LaunchConfiguration('serialized_clouds', default=False)
+    publish_point_time = LaunchConfiguration('publish_point_time', default=False)
+    publish_sensor_id = LaunchConfiguration('publish_sensor_id', default=False)
+    sensor_max_age = LaunchConfiguration('sensor_max_age', default=0.0)
+    merge_deadline = LaunchConfiguration('merge_deadline', default=0.0)
+    voxel_leaf_size = LaunchConfiguration('voxel_leaf_size', default=0.0)
+    voxel_policy = LaunchConfiguration('voxel_policy', default='centroid')
+    footprint_resolution = LaunchConfiguration('footprint_resolution', default=0.01)
+    overload_control = LaunchConfiguration('overload_control', default=False)
+    overload_high = LaunchConfiguration('overload_high', default=0.9)
+    overload_low = LaunchConfiguration('overload_low', default=0.6)
+    realtime_priority = LaunchConfiguration('realtime_priority', default=0)
+    lock_memory = LaunchConfiguration('lock_memory', default=False)
+    prefault_points = LaunchConfiguration('prefault_points', default=0)
+    publish_jitter = LaunchConfiguration('publish_jitter', default=False)
+    merge_trigger = LaunchConfiguration('merge_trigger', default='thread')
+    discover_scan_pattern = LaunchConfiguration('discover_scan_pattern', default='')
+    discover_cloud_pattern = LaunchConfiguration('discover_cloud_pattern', default='')
+    sync_policy = LaunchConfiguration('sync_policy', default='latest')
+    sync_window = LaunchConfiguration('sync_window', default=0.02)
+    sync_depth = LaunchConfiguration('sync_depth', default=5)
 
     output_pointcloud_topic = LaunchConfiguration('output_pointcloud_topic', default="pointcloud")
     output_scan_topic = LaunchConfiguration('output_scan_topic', default="scan")
+    # YAML file for what has no launch argument, the groups.<name> and sensors.<topic> parameters
+    params_file = LaunchConfiguration('params_file', default='')
 
-    return LaunchDescription([
+    optional = [{name: LaunchConfiguration(name)} for name in optional_parameters
+                if LaunchConfiguration(name, default='').perform(context).strip() not in ('', '[]')]
+    if params_file.perform(context):
+        optional.append(params_file)
+
+    return [
         Node(
             package='laser_merger2',
             executable='laser_merger2',
@@ -42,8 +83,13 @@ def generate_launch_description():
                         {'scan_topics': scan_topics},
                         {'point_cloud_topics': point_cloud_topics},
                         {'transform_tolerance': transform_tolerance},
+                        {'tf_lookup': tf_lookup},
+                        {'motion_compensation': motion_compensation},
+                        {'fixed_frame': fixed_frame},
+                        {'twist_topic': twist_topic},
                         {'rate': rate},
                         {'queue_size': queue_size},
+                        {'worker_threads': worker_threads},
                         {'max_range': max_range},
                         {'min_range': min_range},
                         {'max_angle': max_angle},
@@ -51,11 +97,38 @@ def generate_launch_description():
                         {'scan_time': scan_time},
                         {'angle_increment': angle_increment},
                         {'inf_epsilon': inf_epsilon},
-                        {'use_inf': use_inf}
-            ],
+                        {'use_inf': use_inf},
+                        {'serialized_clouds': serialized_clouds},
+                        {'publish_point_time': publish_point_time},
+                        {'publish_sensor_id': publish_sensor_id},
+                        {'sensor_max_age': sensor_max_age},
+                        {'merge_deadline': merge_deadline},
+                        {'voxel_leaf_size': voxel_leaf_size},
+                        {'voxel_policy': voxel_policy},
+                        {'footprint_resolution': footprint_resolution},
+                        {'overload_control': overload_control},
+                        {'overload_high': overload_high},
+                        {'overload_low': overload_low},
+                        {'realtime_priority': realtime_priority},
+                        {'lock_memory': lock_memory},
+                        {'prefault_points': prefault_points},
+                        {'publish_jitter': publish_jitter},
+                        {'merge_trigger': merge_trigger},
+                        {'discover_scan_pattern': discover_scan_pattern},
+                        {'discover_cloud_pattern': discover_cloud_pattern},
+                        {'sync_policy': sync_policy},
+                        {'sync_window': sync_window},
+                        {'sync_depth': sync_depth}
+            ] + optional,
             remappings=[
                 ('/pointcloud', output_pointcloud_topic),
                 ('/scan', output_scan_topic)
             ]
         ),
+    ]
+
+
+def generate_launch_description():
+    return LaunchDescription([
+        OpaqueFunction(function=launch_setup)
     ])
@@ -0,0 +1,196 @@
+#include <laser_merger2/cloud_view.h>
+
+#include <cstring>
+
+namespace
+{
+
+// Minimal little-endian CDR reader, alignment is relative to the end of the encapsulation header
+class CdrReader
+{
+  public:
+    CdrReader(const uint8_t *buffer, size_t size) : buffer_(buffer), size_(size) {}
+
+    bool encapsulation()
+    {
+        // 0x00 0x01 is CDR_LE, anything else is either big-endian or not plain CDR
+        if(size_ < 4 || buffer_[0] != 0x00 || buffer_[1] != 0x01)
+            return false;
+        origin_ = 4;
+        pos_ = 4;
+        return true;
+    }
+
+    template<typename T>
+    bool read(T &value)
+    {
+        align(sizeof(T));
+        if(pos_ + sizeof(T) > size_)
+            return false;
+        std::memcpy(&value, buffer_ + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    bool read(bool &value)
+    {
+        uint8_t byte;
+        if(!read(byte))
+            return false;
+        value = byte != 0;
+        return true;
+    }
+
+    bool read(std::string &value)
+    {
+        uint32_t length;
+        if(!read(length) || length == 0 || pos_ + length > size_)
+            return false;
+        // the serialized length includes the terminating null character
+        value.assign(reinterpret_cast<const char *>(buffer_ + pos_), length - 1);
+        pos_ += length;
+        return true;
+    }
+
+    // Point into the buffer instead of copying a uint8[] sequence
+    bool readBytes(const uint8_t *&data, size_t &length)
+    {
+        uint32_t count;
+        if(!read(count) || pos_ + count > size_)
+            return false;
+        data = buffer_ + pos_;
+        length = count;
+        pos_ += count;
+        return true;
+    }
+
+    size_t remaining() const { return pos_ < size_ ? size_ - pos_ : 0; }
+
+  private:
+    void align(size_t alignment)
+    {
+        pos_ += (alignment - (pos_ - origin_) % alignment) % alignment;
+    }
+
+    const uint8_t *buffer_;
+    size_t size_;
+    size_t origin_ = 0;
+    size_t pos_ = 0;
+};
+
+// name length and terminator, offset, datatype and count, padding left out so it stays a lower bound
+constexpr size_t min_serialized_field = 4 + 1 + 4 + 1 + 4;
+
+size_t datatypeSize(uint8_t datatype)
+{
+    switch(datatype)
+    {
+        case sensor_msgs::msg::PointField::INT8:
+        case sensor_msgs::msg::PointField::UINT8:
+            return 1;
+        case sensor_msgs::msg::PointField::INT16:
+        case sensor_msgs::msg::PointField::UINT16:
+            return 2;
+        case sensor_msgs::msg::PointField::INT32:
+        case sensor_msgs::msg::PointField::UINT32:
+        case sensor_msgs::msg::PointField::FLOAT32:
+            return 4;
+        case sensor_msgs::msg::PointField::FLOAT64:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+}  // namespace
+
+CloudView CloudView::fromMessage(const sensor_msgs::msg::PointCloud2 &cloud)
+{
+    CloudView view;
+    view.header = cloud.header;
+    view.height = cloud.height;
+    view.width = cloud.width;
+    view.point_step = cloud.point_step;
+    view.row_step = cloud.row_step;
+    view.is_bigendian = cloud.is_bigendian;
+    view.fields = cloud.fields;
+    view.data = cloud.data.data();
+    view.data_size = cloud.data.size();
+    return view;
+}
+
+bool CloudView::fromCdr(const rclcpp::SerializedMessage &serialized)
+{
+    const rcl_serialized_message_t &raw = serialized.get_rcl_serialized_message();
+    CdrReader reader(raw.buffer, raw.buffer_length);
+    if(!reader.encapsulation())
+        return false;
+
+    uint32_t field_count;
+    if(!reader.read(header.stamp.sec) || !reader.read(header.stamp.nanosec) || !reader.read(header.frame_id) ||
+       !reader.read(height) || !reader.read(width) || !reader.read(field_count))
+    {
+        return false;
+    }
+
+    // the count comes off the wire, a corrupt one must not turn into a huge allocation
+    if(field_count > reader.remaining() / min_serialized_field)
+        return false;
+
+    fields.resize(field_count);
+    for(auto &cloud_field : fields)
+    {
+        if(!reader.read(cloud_field.name) || !reader.read(cloud_field.offset) ||
+           !reader.read(cloud_field.datatype) || !reader.read(cloud_field.count))
+        {
+            return false;
+        }
+    }
+
+    return reader.read(is_bigendian) && reader.read(point_step) && reader.read(row_step) &&
+           reader.readBytes(data, data_size) && valid();
+}
+
+const sensor_msgs::msg::PointField *CloudView::field(const std::string &name) const
+{
+    for(const auto &cloud_field : fields)
+    {
+        if(cloud_field.name != name)
+            continue;
+
+        const size_t bytes = datatypeSize(cloud_field.datatype);
+        if(bytes == 0 || cloud_field.offset + bytes > point_step)
+            return nullptr;
+        return &cloud_field;
+    }
+    return nullptr;
+}
+
+bool CloudView::valid() const
+{
+    if(size() == 0)
+        return true;
+    if(static_cast<size_t>(width) * point_step > row_step)
+        return false;
+    return static_cast<size_t>(height - 1) * row_step + static_cast<size_t>(width) * point_step <= data_size;
+}
+
+float readCloudScalar(const uint8_t *ptr, uint8_t datatype)
+{
+    return static_cast<float>(readCloudDouble(ptr, datatype));
+}
+
+double readCloudDouble(const uint8_t *ptr, uint8_t datatype)
+{
+    switch(datatype)
+    {
+        case sensor_msgs::msg::PointField::INT8: { int8_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::UINT8: { uint8_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::INT16: { int16_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::UINT16: { uint16_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::INT32: { int32_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::UINT32: { uint32_t v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        case sensor_msgs::msg::PointField::FLOAT64: { double v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+        default: { float v; std::memcpy(&v, ptr, sizeof(v)); return v; }
+    }
+}
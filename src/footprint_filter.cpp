@@ -0,0 +1,170 @@
+#include <laser_merger2/footprint_filter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+// points per crossing test block, the inside flags of a block stay in L1 while every edge sweeps over it
+constexpr size_t block_size = 256;
+
+// above this many cells the footprint is rather tested exactly than rasterized
+constexpr size_t max_grid_cells = 1 << 22;
+}  // namespace
+
+FootprintFilter::FootprintFilter(const std::vector<double> &polygon, const std::vector<double> &boxes, double resolution)
+{
+    const size_t vertices = polygon.size() / 2;
+    const size_t box_count = boxes.size() / 4;
+    empty_ = vertices < 3 && box_count == 0;
+    if(empty_)
+        return;
+
+    min_x_ = min_y_ = std::numeric_limits<float>::max();
+    max_x_ = max_y_ = std::numeric_limits<float>::lowest();
+    bool rectilinear = true;
+    if(vertices >= 3)
+    {
+        for(size_t v = 0; v < vertices; ++v)
+        {
+            const size_t w = (v + 1) % vertices;
+            const float x0 = polygon[2 * v], y0 = polygon[2 * v + 1];
+            const float x1 = polygon[2 * w], y1 = polygon[2 * w + 1];
+            min_x_ = std::min(min_x_, x0);
+            min_y_ = std::min(min_y_, y0);
+            max_x_ = std::max(max_x_, x0);
+            max_y_ = std::max(max_y_, y0);
+            rectilinear &= x0 == x1 || y0 == y1;
+            if(y0 == y1)
+                continue;
+
+            edge_x_.push_back(x0);
+            edge_y0_.push_back(y0);
+            edge_y1_.push_back(y1);
+            edge_slope_.push_back((x1 - x0) / (y1 - y0));
+        }
+    }
+    for(size_t b = 0; b < box_count; ++b)
+    {
+        const float bx0 = std::min(boxes[4 * b], boxes[4 * b + 2]);
+        const float by0 = std::min(boxes[4 * b + 1], boxes[4 * b + 3]);
+        const float bx1 = std::max(boxes[4 * b], boxes[4 * b + 2]);
+        const float by1 = std::max(boxes[4 * b + 1], boxes[4 * b + 3]);
+        boxes_.insert(boxes_.end(), {bx0, by0, bx1, by1});
+        min_x_ = std::min(min_x_, bx0);
+        min_y_ = std::min(min_y_, by0);
+        max_x_ = std::max(max_x_, bx1);
+        max_y_ = std::max(max_y_, by1);
+    }
+
+    if(!rectilinear || resolution <= 0.0)
+        return;
+
+    const double cols = std::ceil((max_x_ - min_x_) / resolution);
+    const double rows = std::ceil((max_y_ - min_y_) / resolution);
+    if(cols * rows > max_grid_cells)
+        return;
+
+    // a cell is inside when its center is, exact when the footprint corners lie on the cell boundaries
+    cols_ = std::max(1, static_cast<int>(cols));
+    rows_ = std::max(1, static_cast<int>(rows));
+    inv_resolution_ = 1.0 / resolution;
+    grid_.resize(static_cast<size_t>(cols_) * rows_);
+    for(int row = 0; row < rows_; ++row)
+    {
+        for(int col = 0; col < cols_; ++col)
+        {
+            const float x = min_x_ + (col + 0.5f) * resolution;
+            const float y = min_y_ + (row + 0.5f) * resolution;
+            grid_[static_cast<size_t>(row) * cols_ + col] = insideShape(x, y);
+        }
+    }
+    rasterized_ = true;
+}
+
+bool FootprintFilter::insideShape(float x, float y) const
+{
+    bool inside = false;
+    for(size_t e = 0; e < edge_x_.size(); ++e)
+    {
+        if((edge_y0_[e] > y) != (edge_y1_[e] > y) && x < edge_x_[e] + (y - edge_y0_[e]) * edge_slope_[e])
+            inside = !inside;
+    }
+    for(size_t b = 0; b < boxes_.size(); b += 4)
+        inside |= x >= boxes_[b] && x <= boxes_[b + 2] && y >= boxes_[b + 1] && y <= boxes_[b + 3];
+    return inside;
+}
+
+void FootprintFilter::classify(const MergedCloud &points, size_t begin, size_t end)
+{
+    const float *px = points.x.data();
+    const float *py = points.y.data();
+    uint8_t *inside = inside_.data();
+
+    if(rasterized_)
+    {
+        for(size_t i = begin; i < end; ++i)
+        {
+            // NaN coordinates fail both bounds and are kept like any other point off the robot
+            const float fx = (px[i] - min_x_) * inv_resolution_;
+            const float fy = (py[i] - min_y_) * inv_resolution_;
+            if(!(fx >= 0.0f && fx < cols_ && fy >= 0.0f && fy < rows_))
+            {
+                inside[i] = 0;
+                continue;
+            }
+            inside[i] = grid_[static_cast<size_t>(fy) * cols_ + static_cast<size_t>(fx)];
+        }
+        return;
+    }
+
+    for(size_t block = begin; block < end; block += block_size)
+    {
+        const size_t block_end = std::min(block + block_size, end);
+        for(size_t i = block; i < block_end; ++i)
+            inside[i] = 0;
+
+        for(size_t e = 0; e < edge_x_.size(); ++e)
+        {
+            const float x0 = edge_x_[e], y0 = edge_y0_[e], y1 = edge_y1_[e], slope = edge_slope_[e];
+            for(size_t i = block; i < block_end; ++i)
+                inside[i] ^= ((y0 > py[i]) != (y1 > py[i])) & (px[i] < x0 + (py[i] - y0) * slope);
+        }
+        for(size_t b = 0; b < boxes_.size(); b += 4)
+        {
+            const float bx0 = boxes_[b], by0 = boxes_[b + 1], bx1 = boxes_[b + 2], by1 = boxes_[b + 3];
+            for(size_t i = block; i < block_end; ++i)
+                inside[i] |= (px[i] >= bx0) & (px[i] <= bx1) & (py[i] >= by0) & (py[i] <= by1);
+        }
+    }
+}
+
+void FootprintFilter::filter(MergedCloud &points, WorkerPool &workers)
+{
+    if(empty_ || points.empty())
+        return;
+
+    inside_.resize(points.size());
+    workers.parallelFor(points.size(), [&](size_t begin, size_t end, size_t)
+        {
+            classify(points, begin, end);
+        }
+    );
+
+    // compact in place, every point is copied down and kept by advancing the end
+    size_t kept = 0;
+    for(size_t i = 0; i < points.size(); ++i)
+    {
+        points.x[kept] = points.x[i];
+        points.y[kept] = points.y[i];
+        points.z[kept] = points.z[i];
+        points.intensity[kept] = points.intensity[i];
+        if(points.has_time)
+            points.t[kept] = points.t[i];
+        if(points.has_sensor_id)
+            points.sensor_id[kept] = points.sensor_id[i];
+        kept += !inside_[i];
+    }
+    points.resize(kept);
+}
@@ -5,17 +5,85 @@
 #include "geometry_msgs/msg/transform_stamped.hpp"
 #include "tf2/LinearMath/Quaternion.h"
 #include "tf2_geometry_msgs/tf2_geometry_msgs.hpp"
+#include "tf2_ros/buffer_interface.h"
 #include <boost/bind.hpp>
-#include <pcl_ros/transforms.hpp>
 
-laser_merger2::laser_merger2() : Node("laser_merger2")
+#include <cstring>
+#include <limits>
+
+namespace
+{
+// heap prefaulted per merged point: the per-sensor and merged columns, a transformed copy and the voxel
+// tables come to about 200 bytes
+constexpr size_t prefault_bytes_per_point = 256;
+
+int64_t steadyNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// out = R * in + t over a slice of SoA columns, m is R row major with t as fourth column.
+// The matrix lives in locals and the columns are restrict, so the loop vectorizes at -O3
+void rigidTransform(const float *__restrict__ x, const float *__restrict__ y, const float *__restrict__ z,
+                    float *__restrict__ ox, float *__restrict__ oy, float *__restrict__ oz,
+                    size_t begin, size_t end, const float (&m)[12])
+{
+    const float r00 = m[0], r01 = m[1], r02 = m[2], tx = m[3];
+    const float r10 = m[4], r11 = m[5], r12 = m[6], ty = m[7];
+    const float r20 = m[8], r21 = m[9], r22 = m[10], tz = m[11];
+    for(size_t i = begin; i < end; ++i)
+    {
+        const float px = x[i], py = y[i], pz = z[i];
+        ox[i] = r00 * px + r01 * py + r02 * pz + tx;
+        oy[i] = r10 * px + r11 * py + r12 * pz + ty;
+        oz[i] = r20 * px + r21 * py + r22 * pz + tz;
+    }
+}
+
+// ranges = min(ranges, partial) over a slice of the scan bins
+void minRanges(float *__restrict__ ranges, const float *__restrict__ partial, size_t begin, size_t end)
+{
+    for(size_t j = begin; j < end; ++j)
+        ranges[j] = std::min(ranges[j], partial[j]);
+}
+
+// Once the ranges are reduced, a bin takes the intensity of a partial array holding the winning range.
+// Both loads are unconditional so the select becomes a blend, a fused min and select loop stays scalar
+void pickIntensities(float *__restrict__ intensities, const float *__restrict__ partial_intensities,
+                     const float *__restrict__ partial_ranges, const float *__restrict__ ranges,
+                     size_t begin, size_t end)
+{
+    for(size_t j = begin; j < end; ++j)
+    {
+        const float current = intensities[j], partial = partial_intensities[j];
+        intensities[j] = partial_ranges[j] == ranges[j] ? partial : current;
+    }
+}
+// 1 where range_min < range < range_max, NaN fails both. Plain arrays and no branch so the compare vectorizes
+void rangeGate(const float *__restrict__ ranges, uint8_t *__restrict__ gate, size_t count, float range_min, float range_max)
+{
+    for(size_t i = 0; i < count; ++i)
+        gate[i] = (ranges[i] > range_min) & (ranges[i] < range_max);
+}
+
+// eight 0/1 bytes to eight bits, byte k lands on bit k
+inline uint64_t packBytes(const uint8_t *bytes)
+{
+    uint64_t word;
+    std::memcpy(&word, bytes, sizeof(word));
+    return (word * 0x0102040810204080ULL) >> 56;
+}
+}  // namespace
+
+laser_merger2::laser_merger2(const rclcpp::NodeOptions &options) : Node("laser_merger2", options)
 {
     this->declare_parameter<std::string>("target_frame", "base_link");
     this->declare_parameter<std::vector<std::string>>("scan_topics", { "/sick_s30b/laser/scan0", "/sick_s30b/laser/scan1" });
     this->declare_parameter<std::vector<std::string>>("point_cloud_topics", { "/sick_s30b/laser/points0", "/sick_s30b/laser/points1" });
-    this->declare_parameter<double>("transform_tolerance", 0.01);
+    this->declare_parameter<double>("transform_tolerance", 0.1);
     this->declare_parameter<double>("rate", 30.0);
     this->declare_parameter<int>("queue_size", 20);
+    this->declare_parameter<int>("worker_threads", 1);
 
     this->declare_parameter<double>("max_range", 30.0);
     this->declare_parameter<double>("min_range", 0.06);
@@ -25,6 +93,40 @@ laser_merger2::laser_merger2() : Node("laser_merger2")
     this->declare_parameter<double>("angle_increment", M_PI / 180.0);
     this->declare_parameter<double>("inf_epsilon", 1.0);
     this->declare_parameter<bool>("use_inf", true);
+    this->declare_parameter<bool>("serialized_clouds", false);
+    this->declare_parameter<bool>("publish_point_time", false);
+    this->declare_parameter<bool>("publish_sensor_id", false);
+    this->declare_parameter<double>("sensor_max_age", 0.0);
+    this->declare_parameter<double>("merge_deadline", 0.0);
+    this->declare_parameter<double>("voxel_leaf_size", 0.0);
+    this->declare_parameter<std::string>("voxel_policy", "centroid");
+    this->declare_parameter<std::vector<double>>("crop_box_min", std::vector<double>());
+    this->declare_parameter<std::vector<double>>("crop_box_max", std::vector<double>());
+    this->declare_parameter<double>("min_height", std::numeric_limits<double>::lowest());
+    this->declare_parameter<double>("max_height", std::numeric_limits<double>::max());
+    this->declare_parameter<std::vector<double>>("footprint", std::vector<double>());
+    this->declare_parameter<std::vector<double>>("footprint_boxes", std::vector<double>());
+    this->declare_parameter<double>("footprint_resolution", 0.01);
+    this->declare_parameter<bool>("overload_control", false);
+    this->declare_parameter<int>("realtime_priority", 0);
+    this->declare_parameter<std::vector<int64_t>>("cpu_affinity", std::vector<int64_t>());
+    this->declare_parameter<bool>("lock_memory", false);
+    this->declare_parameter<int>("prefault_points", 0);
+    this->declare_parameter<bool>("publish_jitter", false);
+    this->declare_parameter<std::string>("merge_trigger", "thread");
+    this->declare_parameter<std::vector<std::string>>("merge_groups", std::vector<std::string>());
+    this->declare_parameter<std::vector<std::string>>("output_frames", std::vector<std::string>());
+    this->declare_parameter<std::string>("discover_scan_pattern", "");
+    this->declare_parameter<std::string>("discover_cloud_pattern", "");
+    this->declare_parameter<double>("overload_high", 0.9);
+    this->declare_parameter<double>("overload_low", 0.6);
+    this->declare_parameter<std::string>("sync_policy", "latest");
+    this->declare_parameter<double>("sync_window", 0.02);
+    this->declare_parameter<int>("sync_depth", 5);
+    this->declare_parameter<std::string>("tf_lookup", "stamped");
+    this->declare_parameter<std::string>("motion_compensation", "none");
+    this->declare_parameter<std::string>("fixed_frame", "odom");
+    this->declare_parameter<std::string>("twist_topic", "twist");
 
     this->get_parameter("target_frame", target_frame_);
     this->get_parameter("scan_topics", scan_topics);
@@ -32,6 +134,7 @@ laser_merger2::laser_merger2() : Node("laser_merger2")
     this->get_parameter("transform_tolerance", tolerance_);
     this->get_parameter("rate", rate_);
     this->get_parameter("queue_size", input_queue_size_);
+    this->get_parameter("worker_threads", worker_threads_);
 
     this->get_parameter("max_range", max_range);
     this->get_parameter("min_range", min_range);
@@ -41,335 +144,1975 @@ laser_merger2::laser_merger2() : Node("laser_merger2")
     this->get_parameter("angle_increment", angle_increment);
     this->get_parameter("inf_epsilon", inf_epsilon);
     this->get_parameter("use_inf", use_inf);
+    this->get_parameter("serialized_clouds", serialized_clouds_);
+    this->get_parameter("publish_point_time", publish_point_time_);
+    this->get_parameter("publish_sensor_id", publish_sensor_id_);
+    this->get_parameter("sensor_max_age", sensor_max_age_);
+    this->get_parameter("merge_deadline", merge_deadline_);
+    this->get_parameter("overload_control", overload_control_);
+    this->get_parameter("realtime_priority", realtime_priority_);
+    this->get_parameter("cpu_affinity", cpu_affinity_);
+    this->get_parameter("lock_memory", lock_memory_);
+    this->get_parameter("prefault_points", prefault_points_);
+    this->get_parameter("overload_high", overload_high_);
+    this->get_parameter("overload_low", overload_low_);
+
+    std::string sync_policy;
+    double sync_window;
+    this->get_parameter("sync_policy", sync_policy);
+    this->get_parameter("sync_window", sync_window);
+    this->get_parameter("sync_depth", sync_depth_);
+    if (sync_policy != "latest" && sync_policy != "approximate") {
+        RCLCPP_WARN(this->get_logger(), "Unknown sync_policy '%s', falling back to 'latest'", sync_policy.c_str());
+    }
+    approximate_sync_ = sync_policy == "approximate";
+    sync_window_ = static_cast<int64_t>(sync_window * 1e9);
+    sync_depth_ = approximate_sync_ ? std::max(sync_depth_, 1) : 1;
+
+    std::string tf_lookup;
+    this->get_parameter("tf_lookup", tf_lookup);
+    if (tf_lookup != "stamped" && tf_lookup != "latest") {
+        RCLCPP_WARN(this->get_logger(), "Unknown tf_lookup '%s', falling back to 'stamped'", tf_lookup.c_str());
+    }
+    stamped_tf_ = tf_lookup != "latest";
+
+    std::string twist_topic;
+    this->get_parameter("motion_compensation", motion_compensation_);
+    this->get_parameter("fixed_frame", fixed_frame_);
+    this->get_parameter("twist_topic", twist_topic);
+    if (motion_compensation_ != "none" && motion_compensation_ != "tf" && motion_compensation_ != "twist") {
+        RCLCPP_WARN(this->get_logger(), "Unknown motion_compensation '%s', disabling it", motion_compensation_.c_str());
+        motion_compensation_ = "none";
+    }
+
+    std::vector<double> crop_box_min, crop_box_max;
+    double min_height, max_height;
+    this->get_parameter("crop_box_min", crop_box_min);
+    this->get_parameter("crop_box_max", crop_box_max);
+    this->get_parameter("min_height", min_height);
+    this->get_parameter("max_height", max_height);
+    if ((!crop_box_min.empty() && crop_box_min.size() != 3) || (!crop_box_max.empty() && crop_box_max.size() != 3)) {
+        RCLCPP_WARN(this->get_logger(), "crop_box_min/crop_box_max need 3 values [x, y, z], ignoring the crop box");
+        crop_box_min.clear();
+        crop_box_max.clear();
+    }
+    crop_box_min.resize(3, std::numeric_limits<double>::lowest());
+    crop_box_max.resize(3, std::numeric_limits<double>::max());
+    crop_box_min[2] = std::max(crop_box_min[2], min_height);
+    crop_box_max[2] = std::min(crop_box_max[2], max_height);
+    crop_.enabled = false;
+    for (int axis = 0; axis < 3; ++axis) {
+        crop_.min[axis] = static_cast<float>(std::max(crop_box_min[axis], double(std::numeric_limits<float>::lowest())));
+        crop_.max[axis] = static_cast<float>(std::min(crop_box_max[axis], double(std::numeric_limits<float>::max())));
+        crop_.enabled |= crop_.min[axis] > std::numeric_limits<float>::lowest() || crop_.max[axis] < std::numeric_limits<float>::max();
+    }
+
+    std::vector<double> footprint, footprint_boxes;
+    double footprint_resolution;
+    this->get_parameter("footprint", footprint);
+    this->get_parameter("footprint_boxes", footprint_boxes);
+    this->get_parameter("footprint_resolution", footprint_resolution);
+    if (footprint.size() % 2 != 0 || (!footprint.empty() && footprint.size() < 6) || footprint_boxes.size() % 4 != 0) {
+        RCLCPP_WARN(this->get_logger(), "footprint needs at least 3 [x, y] vertices and footprint_boxes groups of [min_x, min_y, max_x, max_y], ignoring the self filter");
+        footprint.clear();
+        footprint_boxes.clear();
+    }
+    if (!footprint.empty() || !footprint_boxes.empty()) {
+        footprint_ = std::make_unique<FootprintFilter>(footprint, footprint_boxes, footprint_resolution);
+        RCLCPP_INFO(this->get_logger(), "Self filter uses a %s footprint test", footprint_->rasterized() ? "rasterized" : "polygon crossing");
+    }
+
+    std::string voxel_policy;
+    this->get_parameter("voxel_leaf_size", voxel_leaf_size_);
+    this->get_parameter("voxel_policy", voxel_policy);
+    if (voxel_policy != "centroid" && voxel_policy != "first") {
+        RCLCPP_WARN(this->get_logger(), "Unknown voxel_policy '%s', falling back to 'centroid'", voxel_policy.c_str());
+    }
+    if (voxel_leaf_size_ > 0.0)
+        voxelGrid_ = std::make_unique<VoxelGrid>(voxel_leaf_size_, voxel_policy == "first" ? VoxelGrid::Policy::First : VoxelGrid::Policy::Centroid);
+
+    // the primary group keeps the original topics and outputs, merge_groups adds named ones next to it
+    std::vector<std::string> group_names;
+    std::vector<std::string> output_frames;
+    groupScanTopics_.push_back(scan_topics);
+    groupCloudTopics_.push_back(point_cloud_topics);
+    this->get_parameter("merge_groups", group_names);
+    this->get_parameter("output_frames", output_frames);
+    groups_.push_back(MERGE_GROUP_t{"", {}, {createOutput("", target_frame_, false)}});
+    for (const std::string &frame_id : output_frames)
+    {
+        if (frame_id.find_first_not_of('/') != std::string::npos)
+            groups_.back().outputs.push_back(createOutput("", frame_id, true));
+    }
+    for (const std::string &name : group_names)
+    {
+        const std::string prefix = "groups." + name + ".";
+        this->declare_parameter<std::string>(prefix + "target_frame", target_frame_);
+        this->declare_parameter<std::vector<std::string>>(prefix + "scan_topics", std::vector<std::string>());
+        this->declare_parameter<std::vector<std::string>>(prefix + "point_cloud_topics", std::vector<std::string>());
+        this->declare_parameter<std::vector<std::string>>(prefix + "output_frames", std::vector<std::string>());
+
+        std::string group_frame;
+        groupScanTopics_.emplace_back();
+        groupCloudTopics_.emplace_back();
+        this->get_parameter(prefix + "target_frame", group_frame);
+        this->get_parameter(prefix + "scan_topics", groupScanTopics_.back());
+        this->get_parameter(prefix + "point_cloud_topics", groupCloudTopics_.back());
+        this->get_parameter(prefix + "output_frames", output_frames);
+
+        MERGE_GROUP_t group{name, {}, {createOutput(name + "/", group_frame, false)}};
+        for (const std::string &frame_id : output_frames)
+        {
+            if (frame_id.find_first_not_of('/') != std::string::npos)
+                group.outputs.push_back(createOutput(name + "/", frame_id, true));
+        }
+        RCLCPP_INFO(this->get_logger(), "Merge group %s publishes in %s", name.c_str(), group_frame.c_str());
+        groups_.push_back(group);
+    }
+    bool publish_jitter;
+    this->get_parameter("publish_jitter", publish_jitter);
+    if (publish_jitter)
+        jitterPub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticStatus>("merge_jitter", input_queue_size_);
+    if (overload_control_)
+        loadPub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticStatus>("merge_load", input_queue_size_);
+    if (merge_deadline_ > 0.0)
+        mergeStatusPub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticArray>("merge_status", input_queue_size_);
+    if (publish_sensor_id_)
+    {
+        // latched so late subscribers still get the id table
+        sensorIdPub_ = this->create_publisher<diagnostic_msgs::msg::DiagnosticStatus>("sensor_ids", rclcpp::QoS(1).transient_local());
+    }
 
-    pclPub_ = this->create_publisher<sensor_msgs::msg::PointCloud2>("pointcloud", input_queue_size_);
-    scanPub_ = this->create_publisher<sensor_msgs::msg::LaserScan>("scan", input_queue_size_);
+    // subscriber counts are only re-queried when the ROS graph changes
+    graphEvent_ = this->get_node_graph_interface()->get_graph_event();
+    updateOutputDemand();
 
     rosRate = std::make_shared<rclcpp::Rate>(rate_);
 
+    std::string error;
+    if (lock_memory_ && !lockMemory(error))
+        RCLCPP_WARN(this->get_logger(), "Could not lock memory, %s", error.c_str());
+
+    // workers get the same scheduling as the merge thread they serve
+    const int priority = realtime_priority_;
+    const std::vector<int64_t> cpus = cpu_affinity_;
+    const rclcpp::Logger logger = this->get_logger();
+    // more workers than cores only time-slice the same passes, each split then costs wake-ups and cache
+    size_t worker_count = static_cast<size_t>(std::max(worker_threads_, 1));
+    const size_t cores = cpus.empty() ? std::thread::hardware_concurrency() : cpus.size();
+    if (cores > 0 && worker_count > cores)
+    {
+        RCLCPP_WARN(this->get_logger(), "worker_threads %zu exceeds the %zu cores available, using %zu", worker_count, cores, cores);
+        worker_count = cores;
+    }
+    workers_ = std::make_unique<WorkerPool>(worker_count, [priority, cpus, logger](size_t worker)
+        {
+            std::string error;
+            if ((priority > 0 || !cpus.empty()) && !configureThread(priority, cpus, error))
+                RCLCPP_WARN(logger, "Could not configure worker %zu, %s", worker, error.c_str());
+        }
+    );
+    partialRanges_.resize(workers_->size());
+    partialIntensities_.resize(workers_->size());
+
     tf2_ = std::make_unique<tf2_ros::Buffer>(this->get_clock());
     auto timer_interface = std::make_shared<tf2_ros::CreateTimerROS>(this->get_node_base_interface(), this->get_node_timers_interface());
     tf2_->setCreateTimerInterface(timer_interface);
     tf2_listener_ = std::make_unique<tf2_ros::TransformListener>(*tf2_);
 
-    for(const std::string &scan_topic : scan_topics)
+    std::string discover_scan_pattern, discover_cloud_pattern;
+    this->get_parameter("discover_scan_pattern", discover_scan_pattern);
+    this->get_parameter("discover_cloud_pattern", discover_cloud_pattern);
+    try
     {
-        if (scan_topic.empty())
-            continue;
-        RCLCPP_INFO(this->get_logger(), "Subscribing to topic %s, expecting LaserScan messages", scan_topic.c_str());
-        laser_sub.push_back(this->create_subscription<sensor_msgs::msg::LaserScan>(scan_topic, input_queue_size_, [this](const sensor_msgs::msg::LaserScan::SharedPtr msg)
-            {
-                scanCallback(msg);
-            }
-        ));
+        if (!discover_scan_pattern.empty())
+            discoverScan_ = std::make_unique<std::regex>(discover_scan_pattern, std::regex::ECMAScript | std::regex::optimize);
+        if (!discover_cloud_pattern.empty())
+            discoverCloud_ = std::make_unique<std::regex>(discover_cloud_pattern, std::regex::ECMAScript | std::regex::optimize);
+    }
+    catch (const std::regex_error &ex)
+    {
+        RCLCPP_WARN(this->get_logger(), "Invalid topic discovery pattern, discovery disabled: %s", ex.what());
+        discoverScan_.reset();
+        discoverCloud_.reset();
     }
 
-    for(const std::string &cloud_topic : point_cloud_topics)
+    inputsChanged_ = true;
+    updateInputs();
+    // the topic lists can be changed at runtime, e.g. with ros2 param set, without a restart
+    inputsHandle_ = this->add_on_set_parameters_callback([this](const std::vector<rclcpp::Parameter> &parameters)
+        {
+            return inputsCallback(parameters);
+        }
+    );
+
+    if (motion_compensation_ == "twist")
     {
-        if (cloud_topic.empty())
-            continue;
-        RCLCPP_INFO(this->get_logger(), "Subscribing to topic %s, expecting PointCloud2 messages", cloud_topic.c_str());
-        point_cloud_sub.push_back(this->create_subscription<sensor_msgs::msg::PointCloud2>(cloud_topic, input_queue_size_, [this](const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+        RCLCPP_INFO(this->get_logger(), "Compensating ego-motion with twists from %s", twist_topic.c_str());
+        twist_sub = this->create_subscription<geometry_msgs::msg::TwistStamped>(twist_topic, input_queue_size_, [this](const geometry_msgs::msg::TwistStamped::SharedPtr msg)
             {
-                pointCloudCallback(msg);
+                twistCallback(msg);
             }
-        ));
+        );
     }
 
-    if (laser_sub.empty() && point_cloud_sub.empty()) {
+    if (sensors_.empty() && !discoverScan_ && !discoverCloud_) {
         const char *error_message = "No topic was provided to read input laser scans or point clouds";
         RCLCPP_ERROR(this->get_logger(), error_message);
         throw std::runtime_error(error_message);
     }
     
+    if (discoverScan_ || discoverCloud_)
+        discovery_thread_ = std::thread(std::bind(&laser_merger2::discoveryLoop, this));
+
+    std::string merge_trigger;
+    this->get_parameter("merge_trigger", merge_trigger);
+    if (merge_trigger != "thread" && merge_trigger != "timer") {
+        RCLCPP_WARN(this->get_logger(), "Unknown merge_trigger '%s', falling back to 'thread'", merge_trigger.c_str());
+    }
+    if (merge_trigger == "timer")
+    {
+        if (merge_deadline_ > 0.0)
+            RCLCPP_WARN(this->get_logger(), "merge_deadline is ignored with merge_trigger 'timer', the timer sets the cycle");
+        merge_deadline_ = 0.0;
+
+        // the node clock follows /clock with use_sim_time, so accelerated bag replay merges at replay speed;
+        // a dedicated group lets a multi-threaded executor run the merge next to the subscriptions
+        mergeGroup_ = this->create_callback_group(rclcpp::CallbackGroupType::MutuallyExclusive);
+        timer_ = rclcpp::create_timer(this, this->get_clock(), rclcpp::Duration::from_seconds(1.0 / rate_), [this]()
+            {
+                mergeCycle(false);
+            }, mergeGroup_);
+        return;
+    }
+
     subscription_listener_thread_ = std::thread(std::bind(&laser_merger2::laser_merge, this));
 }
 
 laser_merger2::~laser_merger2()
 {
-    subscription_listener_thread_.join();
-    alive_.store(true);
+    alive_.store(false);
+    inputCv_.notify_all();
+    if (subscription_listener_thread_.joinable())
+        subscription_listener_thread_.join();
+    if (discovery_thread_.joinable())
+        discovery_thread_.join();
 }
 
 
-void laser_merger2::scanCallback(const sensor_msgs::msg::LaserScan::SharedPtr scan)
+void laser_merger2::scanCallback(const sensor_msgs::msg::LaserScan::SharedPtr scan, size_t sensor)
 {
-    std::lock_guard<std::mutex> lock(nodeMutex_);
+    SENSOR_INPUT_t input{sensor, rclcpp::Time(scan->header.stamp).nanoseconds(), scan, {}, {}, false, {}, false};
+    resolveInput(std::move(input));
+}
 
-    laserTime = scan->header.stamp;
-    scanBuffer[scan->header.frame_id] = scan;
+void laser_merger2::pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr cloud, size_t sensor)
+{
+    SENSOR_INPUT_t input{sensor, rclcpp::Time(cloud->header.stamp).nanoseconds(), nullptr, {}, {}, false, {}, false};
+    input.cloud.msg = cloud;
+    input.cloud.view = CloudView::fromMessage(*cloud);
+    resolveInput(std::move(input));
 }
 
-void laser_merger2::pointCloudCallback(const sensor_msgs::msg::PointCloud2::SharedPtr cloud)
+void laser_merger2::serializedCloudCallback(std::shared_ptr<rclcpp::SerializedMessage> serialized, size_t sensor)
 {
-    std::lock_guard<std::mutex> lock(nodeMutex_);
+    SENSOR_INPUT_t input{sensor, 0, nullptr, {}, {}, false, {}, false};
+    if(!input.cloud.view.fromCdr(*serialized))
+    {
+        std::string topic;
+        {
+            std::lock_guard<std::mutex> lock(nodeMutex_);
+            topic = sensors_[sensor].topic;
+        }
+        RCLCPP_WARN(this->get_logger(), "Dropping malformed or big-endian serialized point cloud on %s", topic.c_str());
+        return;
+    }
 
-    laserTime = cloud->header.stamp;
-    pointCloudBuffer[cloud->header.frame_id] = cloud;
+    input.stamp = rclcpp::Time(input.cloud.view.header.stamp).nanoseconds();
+    input.cloud.serialized = serialized;
+    resolveInput(std::move(input));
 }
 
-Eigen::Matrix4d laser_merger2::Rotate3Z(double rad)
+size_t laser_merger2::addSensor(const std::string &topic, bool is_scan)
 {
-    Eigen::Matrix4d res;
-	res.setZero();
-    res(0, 0) = std::cos(rad);
-    res(0, 1) = -1 * std::sin(rad);
-    res(1, 0) = std::sin(rad);
-    res(1, 1) = std::cos(rad);
-    res(2, 2) = 1;
-    res(3, 3) = 1;
+    for(size_t s = 0; s < sensors_.size(); ++s)
+    {
+        if(sensors_[s].topic != topic)
+            continue;
+        if(sensors_[s].is_scan != is_scan)
+            RCLCPP_WARN(this->get_logger(), "Topic %s is listed both as LaserScan and PointCloud2, keeping the first", topic.c_str());
+        if(!sensors_[s].subscription)
+            subscribeSensor(s);
+        return s;
+    }
 
-    return res;
+    // the id is the slot index, a 257th input would wrap onto the first one in the sensor_id field
+    const size_t sensor = sensors_.size();
+    if (publish_sensor_id_ && sensor > std::numeric_limits<uint8_t>::max())
+    {
+        RCLCPP_ERROR(this->get_logger(), "Not subscribing to %s, %zu inputs already use every uint8 sensor_id", topic.c_str(), sensor);
+        return sensor;
+    }
+
+    SENSOR_t slot{topic, is_scan, static_cast<uint8_t>(sensor), "", {}, {}, {}, false, {}, false, 0, loadSensorConfig(topic), {}, {}, {}, nullptr, false, {}};
+    {
+        // callbacks index sensors_ under the lock
+        std::lock_guard<std::mutex> lock(nodeMutex_);
+        sensors_.push_back(std::move(slot));
+    }
+    subscribeSensor(sensor);
+    return sensor;
 }
 
-Eigen::Matrix4d laser_merger2::ConvertTransMatrix(geometry_msgs::msg::TransformStamped trans)
+void laser_merger2::subscribeSensor(size_t sensor)
 {
-    Eigen::Matrix4d res;
-    // Convert geometry_msgs quaternion to tf2 quaternion
-    tf2::Quaternion quaternion;
-    tf2::fromMsg(trans.transform.rotation, quaternion);
+    const std::string topic = sensors_[sensor].topic;
+    const int qos_depth = sensors_[sensor].config.qos_depth;
+    rclcpp::SubscriptionBase::SharedPtr subscription;
+    if (sensors_[sensor].is_scan)
+    {
+        RCLCPP_INFO(this->get_logger(), "Subscribing to topic %s, expecting LaserScan messages", topic.c_str());
+        subscription = this->create_subscription<sensor_msgs::msg::LaserScan>(topic, qos_depth, [this, sensor](const sensor_msgs::msg::LaserScan::SharedPtr msg)
+            {
+                scanCallback(msg, sensor);
+            }
+        );
+    }
+    else if (serialized_clouds_)
+    {
+        RCLCPP_INFO(this->get_logger(), "Subscribing to topic %s, expecting PointCloud2 messages", topic.c_str());
+        // keep the CDR buffer and read the points straight out of it
+        subscription = this->create_subscription<sensor_msgs::msg::PointCloud2>(topic, qos_depth, [this, sensor](std::shared_ptr<rclcpp::SerializedMessage> msg)
+            {
+                serializedCloudCallback(msg, sensor);
+            }
+        );
+    }
+    else
+    {
+        RCLCPP_INFO(this->get_logger(), "Subscribing to topic %s, expecting PointCloud2 messages", topic.c_str());
+        subscription = this->create_subscription<sensor_msgs::msg::PointCloud2>(topic, qos_depth, [this, sensor](const sensor_msgs::msg::PointCloud2::SharedPtr msg)
+            {
+                pointCloudCallback(msg, sensor);
+            }
+        );
+    }
 
-    // Extract RPY angles from tf2 quaternion
-    double roll, pitch, yaw;
-    tf2::Matrix3x3(quaternion).getRPY(roll, pitch, yaw);
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+    sensors_[sensor].subscription = subscription;
+    sensors_[sensor].arrivals.reset(steadyNanoseconds());
+}
 
-	res.setZero();
-    res(0, 0) = std::cos(yaw);
-    res(0, 1) = -1 * std::sin(yaw);
-    res(1, 0) = std::sin(yaw);
-    res(1, 1) = std::cos(yaw);
-	res(0, 3) = trans.transform.translation.x;
-	res(1, 3) = trans.transform.translation.y;
-	res(2, 3) = trans.transform.translation.z;
-	res(2, 2) = 1;
-	res(3, 3) = 1;
+void laser_merger2::removeSensor(size_t sensor)
+{
+    RCLCPP_INFO(this->get_logger(), "Unsubscribing from topic %s", sensors_[sensor].topic.c_str());
 
-	return res;
+    // the slot keeps its index and settings, only the data of the removed topic goes
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+    SENSOR_t &slot = sensors_[sensor];
+    slot.subscription.reset();
+    slot.stalled = false;
+    slot.queue.clear();
+    slot.has_last = false;
+    slot.last = SENSOR_INPUT_t{};
+    slot.points.clear();
+    slot.converted = false;
 }
 
-std::vector<SCAN_POINT_t> laser_merger2::scantoPointXYZ(const sensor_msgs::msg::LaserScan::SharedPtr scan)
+rcl_interfaces::msg::SetParametersResult laser_merger2::inputsCallback(const std::vector<rclcpp::Parameter> &parameters)
 {
-    std::vector<SCAN_POINT_t> points;
-    geometry_msgs::msg::TransformStamped sensorToBase;
+    rcl_interfaces::msg::SetParametersResult result;
+    result.successful = true;
 
-    try
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+    for(const auto &parameter : parameters)
     {
-        sensorToBase = tf2_->lookupTransform(target_frame_, scan->header.frame_id, tf2::TimePointZero);
+        // scan_topics of the primary group, groups.<name>.scan_topics of the named ones
+        const std::string &name = parameter.get_name();
+        for(size_t g = 0; g < groups_.size(); ++g)
+        {
+            const std::string prefix = groups_[g].name.empty() ? "" : "groups." + groups_[g].name + ".";
+            if (name == prefix + "scan_topics")
+                groupScanTopics_[g] = parameter.as_string_array();
+            else if (name == prefix + "point_cloud_topics")
+                groupCloudTopics_[g] = parameter.as_string_array();
+            else
+                continue;
+            inputsChanged_ = true;
+        }
     }
-    catch(const tf2::TransformException & ex)
+    return result;
+}
+
+void laser_merger2::updateInputs()
+{
+    std::vector<std::vector<std::string>> group_scan_topics;
+    std::vector<std::vector<std::string>> group_cloud_topics;
     {
-        RCLCPP_INFO(this->get_logger(), "Could not transform %s to %s: %s", target_frame_.c_str(), scan->header.frame_id.c_str(), ex.what());
-        return points;
+        std::lock_guard<std::mutex> lock(nodeMutex_);
+        if (!inputsChanged_)
+            return;
+        inputsChanged_ = false;
+        group_scan_topics = groupScanTopics_;
+        group_cloud_topics = groupCloudTopics_;
+        group_scan_topics[0].insert(group_scan_topics[0].end(), discoveredScanTopics_.begin(), discoveredScanTopics_.end());
+        group_cloud_topics[0].insert(group_cloud_topics[0].end(), discoveredCloudTopics_.begin(), discoveredCloudTopics_.end());
     }
 
-    const Eigen::Matrix4d T = ConvertTransMatrix(sensorToBase);
-
-    bool has_intensity = scan->intensities.size() == scan->ranges.size();
-    for(size_t i = 0; i < scan->ranges.size(); ++i)
-	{
-		if(scan->ranges[i] <= scan->range_min || scan->ranges[i] >= scan->range_max)
-		{
-			continue;	// no actual measurement
-		}
+    // a topic shared by several groups is subscribed and converted once, unchanged topics keep their
+    // subscription and conversion cache
+    for(size_t g = 0; g < groups_.size(); ++g)
+    {
+        groups_[g].inputs.assign(sensors_.size(), false);
+        for(const std::string &scan_topic : group_scan_topics[g])
+        {
+            if (scan_topic.empty())
+                continue;
+            const size_t sensor = addSensor(scan_topic, true);
+            if (sensor == sensors_.size())
+                continue;
+            groups_[g].inputs.resize(sensors_.size(), false);
+            groups_[g].inputs[sensor] = true;
+        }
+        for(const std::string &cloud_topic : group_cloud_topics[g])
+        {
+            if (cloud_topic.empty())
+                continue;
+            const size_t sensor = addSensor(cloud_topic, false);
+            if (sensor == sensors_.size())
+                continue;
+            groups_[g].inputs.resize(sensors_.size(), false);
+            groups_[g].inputs[sensor] = true;
+        }
+    }
+    for(auto &group : groups_)
+        group.inputs.resize(sensors_.size(), false);
 
-		// transform sensor points into base coordinate system
-		const Eigen::Matrix<double, 4, 1> scanRange{scan->ranges[i], 0, 0, 1};
-		const Eigen::Matrix<double, 4, 1> scanPos = T * Rotate3Z(scan->angle_min + i * scan->angle_increment) * scanRange;
-		SCAN_POINT_t point;
-		point.x = scanPos(0, 0);
-		point.y = scanPos(1, 0);
-        point.z = scanPos(2, 0);
-        if (has_intensity)
-            point.intensity = scan->intensities[i];
-		points.emplace_back(point);
-	}
-	
-	return points;
+    // topics no group lists anymore are dropped
+    for(size_t s = 0; s < sensors_.size(); ++s)
+    {
+        bool used = false;
+        for(const auto &group : groups_)
+            used |= group.inputs[s];
+        if (!used && sensors_[s].subscription)
+            removeSensor(s);
+    }
+    if (publish_sensor_id_ && sensorIdPub_)
+        publishSensorIds();
 }
 
-std::vector<SCAN_POINT_t> laser_merger2::pointCloudtoPointXYZ(const sensor_msgs::msg::PointCloud2::SharedPtr cloud)
+void laser_merger2::discoveryLoop()
 {
-    std::vector<SCAN_POINT_t> points;
+    rclcpp::Context::SharedPtr context = this->get_node_base_interface()->get_context();
+    auto graph = this->get_node_graph_interface();
+    rclcpp::Event::SharedPtr event = graph->get_graph_event();
 
-    sensor_msgs::msg::PointCloud2 transformed_cloud;
-    if (!pcl_ros::transformPointCloud(target_frame_, *cloud, transformed_cloud, *tf2_.get())) {
-        RCLCPP_WARN(this->get_logger(), "Could not transform point cloud");
-        return points;
+    discoverTopics();
+    while(rclcpp::ok(context) && alive_.load())
+    {
+        // sleeps until a publisher or subscription comes or goes, wakes up regularly to notice shutdown
+        graph->wait_for_graph_change(event, std::chrono::milliseconds(100));
+        if(event->check_and_clear())
+            discoverTopics();
     }
+}
 
-    sensor_msgs::PointCloud2ConstIterator<float> iter_x(transformed_cloud, "x");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_y(transformed_cloud, "y");
-    sensor_msgs::PointCloud2ConstIterator<float> iter_z(transformed_cloud, "z");
+void laser_merger2::discoverTopics()
+{
+    // the merged outputs can match a broad pattern, never feed them back
+    std::vector<std::string> outputs;
+    for(const auto &group : groups_)
+    {
+        for(const auto &output : group.outputs)
+        {
+            outputs.push_back(output.cloud_pub->get_topic_name());
+            if(output.scan_pub)
+                outputs.push_back(output.scan_pub->get_topic_name());
+        }
+    }
 
-    bool has_intensity = std::find_if(cloud->fields.begin(), cloud->fields.end(), [](const auto &field) {
-        return field.name == "intensity";
-    }) != cloud->fields.end();
-    sensor_msgs::PointCloud2ConstIterator<float> iter_intensity(transformed_cloud, "intensity");
+    const auto topics = this->get_topic_names_and_types();
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+    for(const auto &topic : topics)
+    {
+        const std::string &name = topic.first;
+        if(std::find(outputs.begin(), outputs.end(), name) != outputs.end())
+            continue;
 
-    for (; iter_x != iter_x.end(); ++iter_x, ++iter_y, ++iter_z) {
-        SCAN_POINT_t point;
-        point.x = *iter_x;
-        point.y = *iter_y;
-        point.z = *iter_z;
+        for(const std::string &type : topic.second)
+        {
+            std::vector<std::string> *discovered = nullptr;
+            if(discoverScan_ && type == "sensor_msgs/msg/LaserScan" && std::regex_match(name, *discoverScan_))
+                discovered = &discoveredScanTopics_;
+            else if(discoverCloud_ && type == "sensor_msgs/msg/PointCloud2" && std::regex_match(name, *discoverCloud_))
+                discovered = &discoveredCloudTopics_;
+            if(!discovered || std::find(discovered->begin(), discovered->end(), name) != discovered->end())
+                continue;
 
-        if (has_intensity) {
-            point.intensity = *iter_intensity;
-            ++iter_intensity;
+            RCLCPP_INFO(this->get_logger(), "Discovered %s publishing %s", name.c_str(), type.c_str());
+            discovered->push_back(name);
+            inputsChanged_ = true;
         }
-
-        points.emplace_back(point);
     }
-
-    return points;
 }
 
-uint32_t laser_merger2::rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b)
+SENSOR_CONFIG_t laser_merger2::loadSensorConfig(const std::string &topic)
 {
-    return ((uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b);
+    // /robot/scan_front is configured under sensors.robot.scan_front
+    std::string name = topic.substr(std::min(topic.find_first_not_of('/'), topic.size()));
+    std::replace(name.begin(), name.end(), '/', '.');
+    const std::string prefix = "sensors." + name + ".";
+
+    this->declare_parameter<double>(prefix + "range_min", 0.0);
+    this->declare_parameter<double>(prefix + "range_max", std::numeric_limits<double>::max());
+    this->declare_parameter<std::vector<double>>(prefix + "exclude_angles", std::vector<double>());
+    this->declare_parameter<int>(prefix + "decimation", 1);
+    this->declare_parameter<double>(prefix + "angular_resolution", 0.0);
+    this->declare_parameter<int>(prefix + "row_stride", 1);
+    this->declare_parameter<int>(prefix + "col_stride", 1);
+    this->declare_parameter<int>(prefix + "priority", 0);
+    this->declare_parameter<std::string>(prefix + "intensity", "keep");
+    this->declare_parameter<double>(prefix + "intensity_scale", 1.0);
+    this->declare_parameter<int>(prefix + "qos_depth", input_queue_size_);
+    this->declare_parameter<std::string>(prefix + "time_reference", "auto");
+
+    SENSOR_CONFIG_t config;
+    std::string intensity;
+    std::string time_reference;
+    double intensity_scale;
+    this->get_parameter(prefix + "range_min", config.range_min);
+    this->get_parameter(prefix + "range_max", config.range_max);
+    this->get_parameter(prefix + "exclude_angles", config.exclude_angles);
+    this->get_parameter(prefix + "decimation", config.decimation);
+    this->get_parameter(prefix + "angular_resolution", config.angular_resolution);
+    this->get_parameter(prefix + "row_stride", config.row_stride);
+    this->get_parameter(prefix + "col_stride", config.col_stride);
+    this->get_parameter(prefix + "priority", config.priority);
+    this->get_parameter(prefix + "intensity", intensity);
+    this->get_parameter(prefix + "intensity_scale", intensity_scale);
+    this->get_parameter(prefix + "qos_depth", config.qos_depth);
+    this->get_parameter(prefix + "time_reference", time_reference);
+    if (config.exclude_angles.size() % 2 != 0) {
+        RCLCPP_WARN(this->get_logger(), "%sexclude_angles needs [start, end] pairs, ignoring it", prefix.c_str());
+        config.exclude_angles.clear();
+    }
+    if (intensity != "keep" && intensity != "zero") {
+        RCLCPP_WARN(this->get_logger(), "Unknown %sintensity '%s', falling back to 'keep'", prefix.c_str(), intensity.c_str());
+    }
+    if (time_reference != "auto" && time_reference != "relative" && time_reference != "absolute") {
+        RCLCPP_WARN(this->get_logger(), "Unknown %stime_reference '%s', falling back to 'auto'", prefix.c_str(), time_reference.c_str());
+    }
+    config.zero_intensity = intensity == "zero";
+    config.time_reference = time_reference == "relative" ? TimeReference::Relative :
+                            time_reference == "absolute" ? TimeReference::Absolute : TimeReference::Auto;
+    config.intensity_scale = intensity_scale;
+    config.decimation = std::max(config.decimation, 1);
+    config.row_stride = std::max(config.row_stride, 1);
+    config.col_stride = std::max(config.col_stride, 1);
+    config.qos_depth = std::max(config.qos_depth, 1);
+    return config;
 }
 
-void laser_merger2::ConvertPointCloud2(std::vector<SCAN_POINT_t> points)
+void laser_merger2::updateBeamMask(const sensor_msgs::msg::LaserScan &scan, SENSOR_t &sensor)
 {
-    if (points.empty())
+    BEAM_MASK_t &mask = sensor.mask;
+    if(mask.size == scan.ranges.size() && mask.angle_min == scan.angle_min && mask.angle_increment == scan.angle_increment)
         return;
 
-    auto pclMsg = std::make_shared<sensor_msgs::msg::PointCloud2>();
-    
-    pclMsg->header.frame_id = target_frame_;
-    pclMsg->header.stamp = laserTime;
-
-    pclMsg->height = 1;
-    pclMsg->width = points.size();
+    mask.angle_min = scan.angle_min;
+    mask.angle_increment = scan.angle_increment;
+    mask.size = scan.ranges.size();
+    mask.bits.assign((mask.size + 63) / 64, 0);
+    mask.group = 1;
+    if(sensor.config.angular_resolution > 0.0 && scan.angle_increment != 0.0f)
+        mask.group = std::max<size_t>(1, std::floor(sensor.config.angular_resolution / std::fabs(scan.angle_increment) + 1e-6));
 
-    sensor_msgs::PointCloud2Modifier modifier(*pclMsg);
-    bool has_intensity = points[0].intensity.has_value();
-    if (has_intensity)
-    {
-        modifier.setPointCloud2Fields(4, "x", 1, sensor_msgs::msg::PointField::FLOAT32,
-                                         "y", 1, sensor_msgs::msg::PointField::FLOAT32,
-                                         "z", 1, sensor_msgs::msg::PointField::FLOAT32,
-                                         "intensity", 1, sensor_msgs::msg::PointField::FLOAT32);
-                                         // "rgb", 1, sensor_msgs::msg::PointField::FLOAT32);
-    }
-    else
+    const std::vector<double> &windows = sensor.config.exclude_angles;
+    for(size_t i = 0; i < mask.size; ++i)
     {
-        modifier.setPointCloud2Fields(4, "x", 1, sensor_msgs::msg::PointField::FLOAT32,
-                                         "y", 1, sensor_msgs::msg::PointField::FLOAT32,
-                                         "z", 1, sensor_msgs::msg::PointField::FLOAT32);
+        const double angle = scan.angle_min + i * scan.angle_increment;
+        bool excluded = false;
+        for(size_t w = 0; w < windows.size(); w += 2)
+        {
+            // both offsets taken in [0, 2pi) so windows may wrap around +-pi
+            // a full turn or more excludes every beam, reduced modulo 2pi it would exclude almost none
+            const double span = windows[w + 1] - windows[w];
+            const double offset = angle - windows[w] - 2 * M_PI * std::floor((angle - windows[w]) / (2 * M_PI));
+            const double width = span >= 2 * M_PI ? 2 * M_PI : span - 2 * M_PI * std::floor(span / (2 * M_PI));
+            excluded |= offset <= width;
+        }
+        excluded |= i % sensor.config.decimation != 0;
+        mask.bits[i / 64] |= uint64_t(!excluded) << (i % 64);
     }
+}
 
-    sensor_msgs::PointCloud2Iterator<float> iter_x(*pclMsg, "x");
-    sensor_msgs::PointCloud2Iterator<float> iter_y(*pclMsg, "y");
-    sensor_msgs::PointCloud2Iterator<float> iter_z(*pclMsg, "z");
-    sensor_msgs::PointCloud2Iterator<float> iter_intensity(*pclMsg, "intensity");
-    //sensor_msgs::PointCloud2Iterator<float> iter_rgb(*pclMsg, "rgb");
+void laser_merger2::selectBeams(const sensor_msgs::msg::LaserScan &scan, SENSOR_t &sensor)
+{
+    updateBeamMask(scan, sensor);
+    const BEAM_MASK_t &mask = sensor.mask;
+    const float range_min = std::max<double>(scan.range_min, sensor.config.range_min);
+    const float range_max = std::min<double>(scan.range_max, sensor.config.range_max);
 
-    for(size_t i = 0; i < pclMsg->width; i++)
+    // range gate into one byte per beam, then pack the bytes eight at a time and apply the static mask
+    sensor.gate.resize(mask.bits.size() * 64);
+    rangeGate(scan.ranges.data(), sensor.gate.data(), mask.size, range_min, range_max);
+    std::fill(sensor.gate.begin() + mask.size, sensor.gate.end(), 0);
+    sensor.beams.resize(mask.bits.size());
+    for(size_t word = 0; word < mask.bits.size(); ++word)
     {
-        //uint32_t rgb_value = rgb_to_uint32(255, 0, 0);
-        *iter_x = points[i].x;
-        *iter_y = points[i].y;
-        *iter_z = points[i].z;
-        if (has_intensity)
-            *iter_intensity = points[i].intensity.value();
+        const uint8_t *gate = sensor.gate.data() + word * 64;
+        uint64_t valid = 0;
+        for(size_t byte = 0; byte < 8; ++byte)
+            valid |= packBytes(gate + byte * 8) << (byte * 8);
+        sensor.beams[word] = valid & mask.bits[word];
+    }
 
-        /*float* rgb_ptr = reinterpret_cast<float*>(&rgb_value);
-        *iter_rgb = *rgb_ptr;*/
+    // overload decimation pools more beams per sample on top of angular_resolution
+    const size_t group = mask.group * loadStride_;
+    if(group == 1)
+        return;
 
-        ++iter_x; ++iter_y; ++iter_z; //++iter_rgb;
-        if (has_intensity)
-            ++iter_intensity;
+    // resample to angular_resolution: only the closest return of each group is kept, so the merged scan loses no obstacle
+    for(size_t begin = 0; begin < mask.size; begin += group)
+    {
+        const size_t end = std::min(begin + group, mask.size);
+        size_t closest = end;
+        for(size_t i = begin; i < end; ++i)
+        {
+            const bool valid = sensor.beams[i / 64] >> (i % 64) & 1;
+            if(valid && (closest == end || scan.ranges[i] < scan.ranges[closest]))
+                closest = i;
+            sensor.beams[i / 64] &= ~(uint64_t(1) << (i % 64));
+        }
+        if(closest != end)
+            sensor.beams[closest / 64] |= uint64_t(1) << (closest % 64);
     }
+}
 
-    pclPub_->publish(*pclMsg);
+const std::string &laser_merger2::inputFrame(const SENSOR_INPUT_t &input)
+{
+    return input.scan ? input.scan->header.frame_id : input.cloud.view.header.frame_id;
 }
 
-void laser_merger2::ConvertLaserScan(std::vector<SCAN_POINT_t> points)
+void laser_merger2::resolveInput(SENSOR_INPUT_t &&input)
 {
-    if (points.empty())
+    // latest-only lookups happen at merge time, which is all static mounts need
+    if(!stamped_tf_)
+    {
+        enqueueInput(std::move(input));
         return;
+    }
 
-    auto scan_msg = std::make_unique<sensor_msgs::msg::LaserScan>();
-    scan_msg->header.stamp = laserTime;
-    scan_msg->header.frame_id = target_frame_;
-    
-    scan_msg->angle_min = min_angle;
-    scan_msg->angle_max = max_angle;
-    scan_msg->angle_increment = angle_increment;
-    scan_msg->time_increment = 0.0;
-    scan_msg->scan_time = scan_time;
-    scan_msg->range_min = min_range;
-    scan_msg->range_max = max_range;
-
-    // determine amount of rays to create
-    uint32_t ranges_size = std::ceil((scan_msg->angle_max - scan_msg->angle_min) / scan_msg->angle_increment);
-    
-    // determine if laserscan rays with no obstacle data will evaluate to infinity or max_range
-    if(use_inf)
-        scan_msg->ranges.assign(ranges_size, std::numeric_limits<double>::infinity());
-    else
-        scan_msg->ranges.assign(ranges_size, scan_msg->range_max + inf_epsilon);
-
-    bool has_intensity = points[0].intensity.has_value();
-    if (has_intensity)
-        scan_msg->intensities.assign(ranges_size, 0);
-
-    for(size_t i = 0; i < points.size(); i++)
+    const std::string &frame = inputFrame(input);
+    const tf2::TimePoint stamp{std::chrono::nanoseconds(input.stamp)};
+    if(tf2_->canTransform(target_frame_, frame, stamp))
     {
-        double range = hypot(points[i].x, points[i].y);
-        double angle = atan2(points[i].y, points[i].x);
-        if(range < min_range || range > max_range || angle < scan_msg->angle_min || angle > scan_msg->angle_max)
+        try
         {
-            continue;
+            input.transform = tf2_->lookupTransform(target_frame_, frame, stamp);
+            input.has_transform = true;
+            enqueueInput(std::move(input));
         }
-        
-        int index = (angle - scan_msg->angle_min) / scan_msg->angle_increment;
-        if(range < scan_msg->ranges[index])
+        catch(const tf2::TransformException & ex)
         {
-            scan_msg->ranges[index] = range;
+            RCLCPP_INFO(this->get_logger(), "Could not transform %s to %s: %s", target_frame_.c_str(), frame.c_str(), ex.what());
         }
-
-        if (has_intensity)
-            scan_msg->intensities[index] = points[i].intensity.value();
+        return;
     }
 
-    scanPub_->publish(std::move(scan_msg));
-}
-
-void laser_merger2::laser_merge()
-{
-    rclcpp::Context::SharedPtr context = this->get_node_base_interface()->get_context();
-    
-    while(rclcpp::ok(context) && alive_.load())
-    {
-        std::vector<SCAN_POINT_t> points;
-        
+    // park the message without blocking until its transform arrives or transform_tolerance expires
+    auto pending = std::make_shared<SENSOR_INPUT_t>(std::move(input));
+    tf2_->waitForTransform(target_frame_, frame, stamp, tf2::durationFromSec(tolerance_),
+        [this, pending](const tf2_ros::TransformStampedFuture &future)
         {
-            std::lock_guard<std::mutex> lock(nodeMutex_);
-
-            // convert all scans to current base frame
-            for(const auto& scan : scanBuffer)
+            try
             {
-                auto scanPoints = scantoPointXYZ(scan.second);
-                points.insert(points.end(), scanPoints.begin(), scanPoints.end());
+                pending->transform = future.get();
+                pending->has_transform = true;
+                enqueueInput(std::move(*pending));
             }
-            scanBuffer.clear();
-
-            for(const auto& cloud : pointCloudBuffer)
+            catch(const tf2::TransformException & ex)
             {
-                auto cloudPoints = pointCloudtoPointXYZ(cloud.second);
-                points.insert(points.end(), cloudPoints.begin(), cloudPoints.end());
+                RCLCPP_INFO(this->get_logger(), "Dropping message from %s, no transform to %s at its stamp: %s",
+                            inputFrame(*pending).c_str(), target_frame_.c_str(), ex.what());
             }
-            pointCloudBuffer.clear();
         }
+    );
+}
 
-        if (!points.empty()) {
-            RCLCPP_DEBUG(this->get_logger(), "Publishing %ld merged points", points.size());
-            ConvertPointCloud2(points);
-            ConvertLaserScan(points);
-        }
+bool laser_merger2::resolveLatest(SENSOR_INPUT_t &input)
+{
+    if(input.has_transform)
+        return true;
 
-        rosRate->sleep();
+    const std::string &frame = inputFrame(input);
+    try
+    {
+        input.transform = tf2_->lookupTransform(target_frame_, frame, tf2::TimePointZero);
+        input.has_transform = true;
     }
-    
-}
\ No newline at end of file
+    catch(const tf2::TransformException & ex)
+    {
+        RCLCPP_INFO(this->get_logger(), "Could not transform %s to %s: %s", target_frame_.c_str(), frame.c_str(), ex.what());
+    }
+    return input.has_transform;
+}
+
+void laser_merger2::enqueueInput(SENSOR_INPUT_t &&input)
+{
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+
+    // the topic was removed while the message was in flight
+    if(!sensors_[input.sensor].subscription)
+        return;
+
+    sensors_[input.sensor].arrivals.arrived(steadyNanoseconds());
+    if(sensors_[input.sensor].stalled)
+    {
+        RCLCPP_INFO(this->get_logger(), "%s delivers again, it is matched again", sensors_[input.sensor].topic.c_str());
+        sensors_[input.sensor].stalled = false;
+    }
+
+    // keep the queue ordered by stamp even if a message arrives late
+    auto &queue = sensors_[input.sensor].queue;
+    auto position = queue.end();
+    while(position != queue.begin() && std::prev(position)->stamp > input.stamp)
+        --position;
+    queue.insert(position, std::move(input));
+
+    while(queue.size() > static_cast<size_t>(sync_depth_))
+        queue.pop_front();
+
+    if(!frameOpen_)
+    {
+        frameOpen_ = true;
+        frameStart_ = std::chrono::steady_clock::now();
+    }
+    inputCv_.notify_one();
+}
+
+void laser_merger2::twistCallback(const geometry_msgs::msg::TwistStamped::SharedPtr twist)
+{
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+
+    latestTwist_ = twist->twist;
+}
+
+bool laser_merger2::targetMotion(int64_t stamp, double &x, double &y, double &yaw)
+{
+    if(motion_compensation_ == "tf")
+    {
+        // target frame as it was at stamp, expressed in the target frame at the reference time
+        tf2::TimePoint source_time{std::chrono::nanoseconds(stamp)};
+        tf2::TimePoint reference_time{std::chrono::nanoseconds(laserTime.nanoseconds())};
+        geometry_msgs::msg::TransformStamped motion;
+        try
+        {
+            // odom usually lags the newest input a little: without waiting on the merge thread, times past
+            // the latest odom sample are clamped to it, i.e. no motion is assumed beyond it
+            const geometry_msgs::msg::TransformStamped latest = tf2_->lookupTransform(fixed_frame_, target_frame_, tf2::TimePointZero);
+            const tf2::TimePoint latest_time{std::chrono::nanoseconds(rclcpp::Time(latest.header.stamp).nanoseconds())};
+            const tf2::TimePoint newest = std::max(source_time, reference_time);
+            if(newest > latest_time && newest - latest_time > tf2::durationFromSec(tolerance_))
+            {
+                RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "%s motion of %s lags the merge by %.3f s, compensating up to its latest sample",
+                                     fixed_frame_.c_str(), target_frame_.c_str(), tf2::durationToSec(newest - latest_time));
+            }
+            source_time = std::min(source_time, latest_time);
+            reference_time = std::min(reference_time, latest_time);
+            motion = tf2_->lookupTransform(target_frame_, reference_time, target_frame_, source_time, fixed_frame_);
+        }
+        catch(const tf2::TransformException & ex)
+        {
+            RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "No %s motion of %s available, merging without compensation: %s",
+                                 fixed_frame_.c_str(), target_frame_.c_str(), ex.what());
+            return false;
+        }
+
+        tf2::Quaternion quaternion;
+        tf2::fromMsg(motion.transform.rotation, quaternion);
+        double roll, pitch;
+        tf2::Matrix3x3(quaternion).getRPY(roll, pitch, yaw);
+        x = motion.transform.translation.x;
+        y = motion.transform.translation.y;
+        return true;
+    }
+
+    // constant body twist integrated from the reference time to stamp
+    geometry_msgs::msg::Twist twist;
+    {
+        std::lock_guard<std::mutex> lock(nodeMutex_);
+        twist = latestTwist_;
+    }
+
+    const double dt = (stamp - laserTime.nanoseconds()) * 1e-9;
+    const double vx = twist.linear.x;
+    const double vy = twist.linear.y;
+    const double wz = twist.angular.z;
+    yaw = wz * dt;
+    if(std::abs(wz) < 1e-6)
+    {
+        x = vx * dt;
+        y = vy * dt;
+    }
+    else
+    {
+        x = (vx * std::sin(yaw) - vy * (1.0 - std::cos(yaw))) / wz;
+        y = (vx * (1.0 - std::cos(yaw)) + vy * std::sin(yaw)) / wz;
+    }
+    return true;
+}
+
+void laser_merger2::compensateMotion(SENSOR_INPUT_t &input)
+{
+    input.has_motion = false;
+    if(motion_compensation_ == "none")
+        return;
+
+    SENSOR_MOTION_t &motion = input.motion;
+    if(!targetMotion(input.stamp, motion.x[0], motion.y[0], motion.yaw[0]))
+        return;
+
+    motion.x[1] = motion.x[0];
+    motion.y[1] = motion.y[0];
+    motion.yaw[1] = motion.yaw[0];
+    input.has_motion = true;
+
+    // scans sweep over scan time, the last beam is captured (n - 1) * time_increment after the stamp
+    if(input.scan && input.scan->ranges.size() > 1 && input.scan->time_increment != 0.0f)
+    {
+        const int64_t sweep = static_cast<int64_t>((input.scan->ranges.size() - 1) * static_cast<double>(input.scan->time_increment) * 1e9);
+        if(!targetMotion(input.stamp + sweep, motion.x[1], motion.y[1], motion.yaw[1]))
+        {
+            motion.x[1] = motion.x[0];
+            motion.y[1] = motion.y[0];
+            motion.yaw[1] = motion.yaw[0];
+        }
+    }
+}
+
+void laser_merger2::publishSensorIds()
+{
+    diagnostic_msgs::msg::DiagnosticStatus table;
+    table.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    table.name = std::string(this->get_name()) + ": sensor ids";
+    table.message = "sensor_id -> frame_id of the merged cloud points";
+    for(const auto &sensor : sensors_)
+    {
+        if(!sensor.subscription)
+            continue;
+        diagnostic_msgs::msg::KeyValue entry;
+        entry.key = std::to_string(sensor.id);
+        entry.value = sensor.frame_id;
+        table.values.push_back(entry);
+    }
+    sensorIdPub_->publish(table);
+}
+
+std::vector<size_t> laser_merger2::activeSensors(const std::vector<SENSOR_INPUT_t> &inputs)
+{
+    std::vector<size_t> active;
+    std::vector<bool> fresh(sensors_.size(), false);
+    for(const auto& input : inputs)
+    {
+        SENSOR_t &sensor = sensors_[input.sensor];
+        sensor.last = input;
+        sensor.has_last = true;
+        sensor.converted = false;
+        fresh[input.sensor] = true;
+    }
+
+    const int64_t now = this->now().nanoseconds();
+    for(size_t s = 0; s < sensors_.size(); ++s)
+    {
+        SENSOR_t &sensor = sensors_[s];
+        if(!sensor.has_last)
+            continue;
+
+        // without a max age only the inputs received for this merge are used, like before
+        const double age = (now - sensor.last.stamp) * 1e-9;
+        if(fresh[s] || (sensor_max_age_ > 0.0 && age <= sensor_max_age_))
+        {
+            active.push_back(s);
+            continue;
+        }
+
+        if(sensor_max_age_ > 0.0)
+            RCLCPP_WARN(this->get_logger(), "Dropping %s from the merge, its last data is %.3f s old", sensor.topic.c_str(), age);
+        sensor.has_last = false;
+        sensor.last = SENSOR_INPUT_t{};
+        sensor.points.clear();
+        sensor.converted = false;
+    }
+
+    std::stable_sort(active.begin(), active.end(), [this](size_t a, size_t b)
+        {
+            return sensors_[a].config.priority > sensors_[b].config.priority;
+        }
+    );
+    return active;
+}
+
+bool laser_merger2::matchQueues(bool partial, std::vector<size_t> &matched, std::vector<size_t> &picks)
+{
+    matched.clear();
+    std::vector<std::vector<int64_t>> stamps;
+    for(size_t s = 0; s < sensors_.size(); ++s)
+    {
+        if(!sensors_[s].subscription || sensors_[s].stalled || (partial && sensors_[s].queue.empty()))
+            continue;
+
+        matched.push_back(s);
+        stamps.emplace_back();
+        for(const auto &input : sensors_[s].queue)
+            stamps.back().push_back(input.stamp);
+    }
+
+    return matchTightestSet(stamps, sync_window_, picks);
+}
+
+bool laser_merger2::frameReady()
+{
+    for(const auto &sensor : sensors_)
+    {
+        if(sensor.subscription && !sensor.stalled && sensor.queue.empty())
+            return false;
+    }
+
+    std::vector<size_t> matched, picks;
+    return !approximate_sync_ || matchQueues(false, matched, picks);
+}
+
+void laser_merger2::updateStalled()
+{
+    // a sensor that stopped publishing must not block every match: once silent for several of its own
+    // periods it is left out of the sets until its next message. A slow sensor between two messages is not,
+    // whatever the rates of the others
+    const int64_t now = steadyNanoseconds();
+    int64_t slowest = 0;
+    for(const auto &sensor : sensors_)
+    {
+        if(sensor.subscription)
+            slowest = std::max(slowest, sensor.arrivals.period());
+    }
+
+    for(auto &sensor : sensors_)
+    {
+        if(!sensor.subscription || sensor.stalled || !sensor.arrivals.stalled(now, slowest, sync_window_))
+            continue;
+        RCLCPP_WARN(this->get_logger(), "%s stopped delivering, matching the other sensors without it", sensor.topic.c_str());
+        sensor.stalled = true;
+        // what it left can no longer match the current stamps of the others
+        sensor.queue.clear();
+    }
+}
+
+std::vector<SENSOR_INPUT_t> laser_merger2::selectInputs(bool partial)
+{
+    std::lock_guard<std::mutex> lock(nodeMutex_);
+    std::vector<SENSOR_INPUT_t> inputs;
+    if(approximate_sync_)
+        updateStalled();
+
+    std::vector<size_t> matched, picks;
+    if(!approximate_sync_ || !matchQueues(partial, matched, picks))
+    {
+        // merge whatever each sensor delivered last, also what is left of an incomplete set past its deadline
+        if(approximate_sync_ && !partial)
+            return inputs;
+
+        for(auto &sensor : sensors_)
+        {
+            if(sensor.queue.empty())
+                continue;
+            inputs.push_back(std::move(sensor.queue.back()));
+            sensor.queue.clear();
+        }
+        return inputs;
+    }
+
+    // older messages can no longer be part of a tighter set
+    for(size_t m = 0; m < matched.size(); ++m)
+    {
+        auto &queue = sensors_[matched[m]].queue;
+        inputs.push_back(std::move(queue[picks[m]]));
+        queue.erase(queue.begin(), queue.begin() + picks[m] + 1);
+        if(!queue.empty() && !frameOpen_)
+        {
+            // leftovers already belong to the next frame
+            frameOpen_ = true;
+            frameStart_ = std::chrono::steady_clock::now();
+        }
+    }
+    return inputs;
+}
+
+bool laser_merger2::waitForMerge()
+{
+    if(merge_deadline_ <= 0.0)
+    {
+        rosRate->sleep();
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(nodeMutex_);
+
+    // a frame opens with its first message, wake up regularly to notice shutdown
+    if(!inputCv_.wait_for(lock, std::chrono::milliseconds(100), [this] { return frameOpen_ || !alive_.load(); }) || !alive_.load())
+        return false;
+
+    // then closes once every sensor delivered or when the deadline expires, whichever comes first
+    const auto deadline = frameStart_ + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(merge_deadline_));
+    const bool complete = inputCv_.wait_until(lock, deadline, [this] { return frameReady() || !alive_.load(); });
+    frameOpen_ = false;
+    return !complete;
+}
+
+void laser_merger2::publishMergeStatus(const std::vector<SENSOR_INPUT_t> &inputs)
+{
+    std::vector<bool> delivered(sensors_.size(), false);
+    for(const auto& input : inputs)
+        delivered[input.sensor] = true;
+
+    uint64_t missing_mask = 0;
+    std::string missing;
+    for(size_t s = 0; s < sensors_.size(); ++s)
+    {
+        if(delivered[s] || !sensors_[s].subscription)
+            continue;
+        if(s < 64)
+            missing_mask |= uint64_t(1) << s;
+        missing += (missing.empty() ? "" : ",") + sensors_[s].topic;
+    }
+
+    diagnostic_msgs::msg::DiagnosticArray status_msg;
+    status_msg.header.stamp = laserTime;
+    status_msg.header.frame_id = target_frame_;
+
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = std::string(this->get_name()) + ": merge";
+    status.level = !missing.empty() ? diagnostic_msgs::msg::DiagnosticStatus::WARN : diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = missing.empty() ? "all sensors merged" : "merged without late sensors";
+
+    char mask[19];
+    std::snprintf(mask, sizeof(mask), "0x%016llx", static_cast<unsigned long long>(missing_mask));
+    diagnostic_msgs::msg::KeyValue entry;
+    entry.key = "missing_mask";
+    entry.value = mask;
+    status.values.push_back(entry);
+    entry.key = "missing";
+    entry.value = missing;
+    status.values.push_back(entry);
+
+    status_msg.status.push_back(status);
+    mergeStatusPub_->publish(status_msg);
+}
+
+Eigen::Matrix4d laser_merger2::Rotate3Z(double rad)
+{
+    Eigen::Matrix4d res;
+	res.setZero();
+    res(0, 0) = std::cos(rad);
+    res(0, 1) = -1 * std::sin(rad);
+    res(1, 0) = std::sin(rad);
+    res(1, 1) = std::cos(rad);
+    res(2, 2) = 1;
+    res(3, 3) = 1;
+
+    return res;
+}
+
+Eigen::Matrix4d laser_merger2::ConvertTransMatrix(geometry_msgs::msg::TransformStamped trans)
+{
+    Eigen::Matrix4d res;
+    // Convert geometry_msgs quaternion to tf2 quaternion
+    tf2::Quaternion quaternion;
+    tf2::fromMsg(trans.transform.rotation, quaternion);
+
+    // Extract RPY angles from tf2 quaternion
+    double roll, pitch, yaw;
+    tf2::Matrix3x3(quaternion).getRPY(roll, pitch, yaw);
+
+	res.setZero();
+    res(0, 0) = std::cos(yaw);
+    res(0, 1) = -1 * std::sin(yaw);
+    res(1, 0) = std::sin(yaw);
+    res(1, 1) = std::cos(yaw);
+	res(0, 3) = trans.transform.translation.x;
+	res(1, 3) = trans.transform.translation.y;
+	res(2, 3) = trans.transform.translation.z;
+	res(2, 2) = 1;
+	res(3, 3) = 1;
+
+	return res;
+}
+
+Eigen::Matrix4d laser_merger2::motionAt(const SENSOR_MOTION_t &motion, double ratio)
+{
+    Eigen::Matrix4d res = Rotate3Z(motion.yaw[0] + ratio * (motion.yaw[1] - motion.yaw[0]));
+    res(0, 3) = motion.x[0] + ratio * (motion.x[1] - motion.x[0]);
+    res(1, 3) = motion.y[0] + ratio * (motion.y[1] - motion.y[0]);
+    return res;
+}
+
+void laser_merger2::scantoPointXYZ(const SENSOR_INPUT_t &input, MergedCloud &points)
+{
+    const auto &scan = input.scan;
+    const Eigen::Matrix4d T = ConvertTransMatrix(input.transform);
+    const double sweep = scan->ranges.size() > 1 ? 1.0 / (scan->ranges.size() - 1) : 0.0;
+    SENSOR_t &sensor = sensors_[input.sensor];
+    const bool has_intensity = !sensor.config.zero_intensity && scan->intensities.size() == scan->ranges.size();
+    const float intensity_scale = sensor.config.intensity_scale;
+    points.has_intensity &= has_intensity || sensor.config.zero_intensity;
+    const uint8_t sensor_id = sensor.id;
+    selectBeams(*scan, sensor);
+
+    // every beam is written at the end of the buffer and only kept by advancing the end, no branch on the outcome
+    size_t kept = points.size();
+    points.resize(kept + scan->ranges.size());
+    for(size_t word = 0; word < sensor.beams.size(); ++word)
+    {
+        // only the selected beams get transformed
+        const size_t base = word * 64;
+        uint64_t valid = sensor.beams[word];
+        for(; valid != 0; valid &= valid - 1)
+        {
+            const size_t i = base + __builtin_ctzll(valid);
+
+            // transform sensor points into base coordinate system
+            const Eigen::Matrix<double, 4, 1> scanRange{scan->ranges[i], 0, 0, 1};
+            Eigen::Matrix<double, 4, 1> scanPos = T * Rotate3Z(scan->angle_min + i * scan->angle_increment) * scanRange;
+            if (input.has_motion)
+                scanPos = motionAt(input.motion, i * sweep) * scanPos;
+
+            const float x = scanPos(0, 0), y = scanPos(1, 0), z = scanPos(2, 0);
+            points.x[kept] = x;
+            points.y[kept] = y;
+            points.z[kept] = z;
+            points.intensity[kept] = has_intensity ? scan->intensities[i] * intensity_scale : 0.0f;
+            if (points.has_time)
+                points.t[kept] = i * scan->time_increment;
+            if (points.has_sensor_id)
+                points.sensor_id[kept] = sensor_id;
+
+            kept += insideCrop(x, y, z);
+        }
+    }
+    points.resize(kept);
+}
+
+bool laser_merger2::insideCrop(float x, float y, float z) const
+{
+    return (x >= crop_.min[0]) & (x <= crop_.max[0]) &
+           (y >= crop_.min[1]) & (y <= crop_.max[1]) &
+           (z >= crop_.min[2]) & (z <= crop_.max[2]);
+}
+
+void laser_merger2::pointCloudtoPointXYZ(const SENSOR_INPUT_t &input, MergedCloud &points)
+{
+    const CloudView &cloud = input.cloud.view;
+    const auto *field_x = cloud.field("x");
+    const auto *field_y = cloud.field("y");
+    const auto *field_z = cloud.field("z");
+    auto is_float = [](const sensor_msgs::msg::PointField *field)
+    {
+        return field && field->datatype == sensor_msgs::msg::PointField::FLOAT32;
+    };
+    if (!is_float(field_x) || !is_float(field_y) || !is_float(field_z) || cloud.is_bigendian || !cloud.valid()) {
+        RCLCPP_WARN(this->get_logger(), "Ignoring point cloud from %s without a readable x/y/z layout", cloud.header.frame_id.c_str());
+        return;
+    }
+
+    const auto &rotation = input.transform.transform.rotation;
+    const auto &translation = input.transform.transform.translation;
+    Eigen::Matrix3f R = Eigen::Quaternionf(rotation.w, rotation.x, rotation.y, rotation.z).toRotationMatrix();
+    Eigen::Vector3f t(translation.x, translation.y, translation.z);
+    if (input.has_motion) {
+        // fold the ego-motion into the sensor transform, clouds are compensated per message
+        const Eigen::Matrix4d M = motionAt(input.motion, 0.0);
+        const Eigen::Matrix3f Rm = M.block<3, 3>(0, 0).cast<float>();
+        t = Rm * t + M.block<3, 1>(0, 3).cast<float>();
+        R = Rm * R;
+    }
+
+    const SENSOR_CONFIG_t &config = sensors_[input.sensor].config;
+    const auto *field_intensity = config.zero_intensity ? nullptr : cloud.field("intensity");
+    points.has_intensity &= field_intensity != nullptr || config.zero_intensity;
+
+    // per-point time passes through, integer fields are nanoseconds and floating point ones seconds.
+    // Absolute times (e.g. FLOAT64 timestamp of Hesai and Livox drivers) are made relative to the stamp
+    const sensor_msgs::msg::PointField *field_time = nullptr;
+    for (const char *name : {"t", "time", "timestamp"}) {
+        if ((field_time = cloud.field(name)) != nullptr)
+            break;
+    }
+    const bool time_in_ns = field_time && field_time->datatype != sensor_msgs::msg::PointField::FLOAT32 &&
+                            field_time->datatype != sensor_msgs::msg::PointField::FLOAT64;
+    // a relative time is well below a day, an absolute one above 1e9 s since 2001, or 1e18 when a
+    // floating point field carries nanoseconds (Livox)
+    const double absolute_time_threshold = 1e6;
+    const double absolute_ns_threshold = 1e15;
+    const double stamp_time = input.stamp * 1e-9;
+    const uint8_t sensor_id = sensors_[input.sensor].id;
+    // limits are on the distance to the sensor, compared squared and clamped so the square stays finite
+    const float range_max = std::min<double>(config.range_max, std::sqrt(std::numeric_limits<float>::max()));
+    const float range_min_sq = config.range_min * config.range_min;
+    const float range_max_sq = range_max * range_max;
+
+    size_t kept = points.size();
+    points.resize(kept + cloud.size());
+    // organized clouds are strided in both directions, unorganized ones (height 1) only along their single row
+    const size_t col_stride = config.col_stride * loadStride_;
+    const size_t point_stride = col_stride * cloud.point_step;
+    for (uint32_t row = 0; row < cloud.height; row += config.row_stride) {
+        const uint8_t *point = cloud.data + static_cast<size_t>(row) * cloud.row_step;
+        for (uint32_t col = 0; col < cloud.width; col += col_stride, point += point_stride) {
+            Eigen::Vector3f p;
+            std::memcpy(&p[0], point + field_x->offset, sizeof(float));
+            std::memcpy(&p[1], point + field_y->offset, sizeof(float));
+            std::memcpy(&p[2], point + field_z->offset, sizeof(float));
+
+            const Eigen::Vector3f q = R * p + t;
+            const float range_sq = p.squaredNorm();
+            points.x[kept] = q.x();
+            points.y[kept] = q.y();
+            points.z[kept] = q.z();
+            points.intensity[kept] = field_intensity ? readCloudScalar(point + field_intensity->offset, field_intensity->datatype) * config.intensity_scale : 0.0f;
+            if (points.has_time) {
+                double point_time = field_time ? readCloudDouble(point + field_time->offset, field_time->datatype) : 0.0;
+                if (time_in_ns || std::fabs(point_time) > absolute_ns_threshold)
+                    point_time *= 1e-9;
+                if (config.time_reference == TimeReference::Absolute ||
+                    (config.time_reference == TimeReference::Auto && std::fabs(point_time) > absolute_time_threshold))
+                    point_time -= stamp_time;
+                points.t[kept] = static_cast<float>(point_time);
+            }
+            if (points.has_sensor_id)
+                points.sensor_id[kept] = sensor_id;
+
+            // organized clouds mark missing returns with NaN, the crop test drops them along with the cropped points
+            kept += (range_sq >= range_min_sq) & (range_sq <= range_max_sq) & insideCrop(q.x(), q.y(), q.z());
+        }
+    }
+    points.resize(kept);
+}
+
+uint32_t laser_merger2::rgb_to_uint32(uint8_t r, uint8_t g, uint8_t b)
+{
+    return ((uint32_t)r << 16 | (uint32_t)g << 8 | (uint32_t)b);
+}
+
+void laser_merger2::ConvertPointCloud2(MergedCloud &points, const MERGE_OUTPUT_t &output)
+{
+    if (points.empty())
+        return;
+
+    // hand the merge buffer over to the publisher, PointCloud2 packing only happens for inter-process subscribers
+    auto pclMsg = std::make_unique<MergedCloud>(std::move(points));
+    pclMsg->header.frame_id = output.frame_id;
+    pclMsg->header.stamp = laserTime;
+
+    output.cloud_pub->publish(std::move(pclMsg));
+    points.clear();
+}
+
+sensor_msgs::msg::LaserScan::UniquePtr laser_merger2::createLaserScan(bool has_intensity, const std::string &frame_id)
+{
+    auto scan_msg = std::make_unique<sensor_msgs::msg::LaserScan>();
+    scan_msg->header.stamp = laserTime;
+    scan_msg->header.frame_id = frame_id;
+    
+    scan_msg->angle_min = min_angle;
+    scan_msg->angle_max = max_angle;
+    scan_msg->angle_increment = angle_increment;
+    scan_msg->time_increment = 0.0;
+    scan_msg->scan_time = scan_time;
+    scan_msg->range_min = min_range;
+    scan_msg->range_max = max_range;
+
+    // determine amount of rays to create
+    uint32_t ranges_size = std::ceil((scan_msg->angle_max - scan_msg->angle_min) / scan_msg->angle_increment);
+    
+    // determine if laserscan rays with no obstacle data will evaluate to infinity or max_range
+    if(use_inf)
+        scan_msg->ranges.assign(ranges_size, std::numeric_limits<double>::infinity());
+    else
+        scan_msg->ranges.assign(ranges_size, scan_msg->range_max + inf_epsilon);
+
+    if (has_intensity)
+        scan_msg->intensities.assign(ranges_size, 0);
+
+    return scan_msg;
+}
+
+int laser_merger2::scanIndex(double angle, size_t ranges_size)
+{
+    if(angle < min_angle || angle > max_angle)
+        return -1;
+
+    // angle == max_angle lands one past the last ray when the span is a multiple of the increment
+    int index = (angle - min_angle) / angle_increment;
+    return index < static_cast<int>(ranges_size) ? index : -1;
+}
+
+void laser_merger2::binPoints(const MergedCloud &points, size_t begin, size_t end, float *ranges, float *intensities, size_t ranges_size)
+{
+    for(size_t i = begin; i < end; i++)
+    {
+        double range = hypot(points.x[i], points.y[i]);
+        double angle = atan2(points.y[i], points.x[i]);
+        if(range < min_range || range > max_range)
+        {
+            continue;
+        }
+        
+        int index = scanIndex(angle, ranges_size);
+        if(index < 0 || range >= ranges[index])
+        {
+            continue;
+        }
+
+        // keep the intensity of the closest return so both scan paths agree
+        ranges[index] = range;
+        if (intensities)
+            intensities[index] = points.intensity[i];
+    }
+}
+
+void laser_merger2::ConvertLaserScan(const MergedCloud &points, const MERGE_OUTPUT_t &output)
+{
+    // below this size the per-worker bins cost more to clear and merge than they save
+    const size_t parallel_min_points = 20000;
+
+    if (points.empty())
+        return;
+
+    bool has_intensity = points.has_intensity;
+    auto scan_msg = createLaserScan(has_intensity, output.frame_id);
+    const size_t ranges_size = scan_msg->ranges.size();
+    float *ranges = scan_msg->ranges.data();
+    float *intensities = has_intensity ? scan_msg->intensities.data() : nullptr;
+
+    if(workers_->size() == 1 || points.size() < parallel_min_points)
+    {
+        binPoints(points, 0, points.size(), ranges, intensities, ranges_size);
+        output.scan_pub->publish(std::move(scan_msg));
+        return;
+    }
+
+    // every worker bins its slice of the points into private arrays, no atomics and no shared cache lines
+    workers_->parallelFor(points.size(), [&](size_t begin, size_t end, size_t worker)
+        {
+            auto &partial_ranges = partialRanges_[worker];
+            auto &partial_intensities = partialIntensities_[worker];
+            partial_ranges.assign(ranges_size, std::numeric_limits<float>::infinity());
+            if (has_intensity)
+                partial_intensities.assign(ranges_size, 0);
+
+            binPoints(points, begin, end, partial_ranges.data(),
+                      has_intensity ? partial_intensities.data() : nullptr, ranges_size);
+        }
+    );
+
+    // then each worker owns one angular sector of the output and min-reduces the private arrays into it
+    workers_->parallelFor(ranges_size, [&](size_t begin, size_t end, size_t)
+        {
+            for(size_t w = 0; w < partialRanges_.size(); ++w)
+                minRanges(ranges, partialRanges_[w].data(), begin, end);
+
+            // walked backwards so on a tie the first worker wins, as with a strict < select
+            if (has_intensity)
+            {
+                for(size_t w = partialRanges_.size(); w-- > 0;)
+                    pickIntensities(intensities, partialIntensities_[w].data(), partialRanges_[w].data(),
+                                    ranges, begin, end);
+            }
+        }
+    );
+
+    output.scan_pub->publish(std::move(scan_msg));
+}
+
+void laser_merger2::updateScanTable(const SENSOR_INPUT_t &input, SCAN_TABLE_t &table)
+{
+    const auto &scan = input.scan;
+    const geometry_msgs::msg::TransformStamped &sensorToBase = input.transform;
+
+    tf2::Quaternion quaternion;
+    tf2::fromMsg(sensorToBase.transform.rotation, quaternion);
+    double roll, pitch, yaw;
+    tf2::Matrix3x3(quaternion).getRPY(roll, pitch, yaw);
+
+    const double dx = sensorToBase.transform.translation.x;
+    const double dy = sensorToBase.transform.translation.y;
+
+    // tables only depend on the beam layout and the sensor pose, rebuild them when either changes
+    if(table.size == scan->ranges.size() && table.angle_min == scan->angle_min && table.angle_increment == scan->angle_increment &&
+       table.dx == dx && table.dy == dy && table.yaw == yaw)
+    {
+        return;
+    }
+
+    table.angle_min = scan->angle_min;
+    table.angle_increment = scan->angle_increment;
+    table.size = scan->ranges.size();
+    table.dx = dx;
+    table.dy = dy;
+    table.yaw = yaw;
+    table.centered = std::hypot(dx, dy) < 1e-6;
+
+    table.cos_beam.resize(table.size);
+    table.sin_beam.resize(table.size);
+    table.bin.clear();
+
+    const size_t ranges_size = std::ceil((max_angle - min_angle) / angle_increment);
+    for(size_t i = 0; i < table.size; ++i)
+    {
+        const double beam = yaw + table.angle_min + i * table.angle_increment;
+        table.cos_beam[i] = std::cos(beam);
+        table.sin_beam[i] = std::sin(beam);
+        if(table.centered)
+            table.bin.push_back(scanIndex(std::atan2(table.sin_beam[i], table.cos_beam[i]), ranges_size));
+    }
+}
+
+void laser_merger2::projectScansDirect(const std::vector<SENSOR_INPUT_t> &inputs, const MERGE_OUTPUT_t &output)
+{
+    bool has_intensity = true;
+    for(const auto& input : inputs)
+        has_intensity &= sensors_[input.sensor].config.zero_intensity || input.scan->intensities.size() == input.scan->ranges.size();
+
+    auto scan_msg = createLaserScan(has_intensity, output.frame_id);
+    const size_t ranges_size = scan_msg->ranges.size();
+    float *ranges = scan_msg->ranges.data();
+    float *intensities = scan_msg->intensities.data();
+
+    for(const auto& input : inputs)
+    {
+        const auto &scan = input.scan;
+        SENSOR_t &sensor = sensors_[input.sensor];
+        SCAN_TABLE_t &table = sensor.table;
+        updateScanTable(input, table);
+        selectBeams(*scan, sensor);
+        const bool sensor_intensity = has_intensity && !sensor.config.zero_intensity;
+        const double sweep = table.size > 1 ? 1.0 / (table.size - 1) : 0.0;
+
+        const float *scan_ranges = scan->ranges.data();
+        for(size_t i = 0; i < table.size; ++i)
+        {
+            const float r = scan_ranges[i];
+            if(!(sensor.beams[i / 64] >> (i % 64) & 1))
+                continue;   // no actual measurement, or a masked beam
+
+            double range;
+            int index;
+            if(table.centered && !input.has_motion)
+            {
+                range = r;
+                index = table.bin[i];
+            }
+            else
+            {
+                double x = r * table.cos_beam[i] + table.dx;
+                double y = r * table.sin_beam[i] + table.dy;
+                if(input.has_motion)
+                {
+                    const Eigen::Matrix4d M = motionAt(input.motion, i * sweep);
+                    const double mx = M(0, 0) * x + M(0, 1) * y + M(0, 3);
+                    y = M(1, 0) * x + M(1, 1) * y + M(1, 3);
+                    x = mx;
+                }
+                range = std::hypot(x, y);
+                index = scanIndex(std::atan2(y, x), ranges_size);
+            }
+
+            if(index < 0 || range < min_range || range > max_range || range >= ranges[index])
+                continue;
+
+            ranges[index] = range;
+            if(has_intensity)
+                intensities[index] = sensor_intensity ? scan->intensities[i] * sensor.config.intensity_scale : 0.0f;
+        }
+    }
+
+    output.scan_pub->publish(std::move(scan_msg));
+}
+
+MERGE_OUTPUT_t laser_merger2::createOutput(const std::string &prefix, const std::string &frame_id, bool extra)
+{
+    // extra frames publish a cloud next to the group outputs, e.g. pointcloud_odom. They get no scan:
+    // range and bearing only mean something from the robot, not from the origin of a world-fixed frame
+    if (extra)
+    {
+        const std::string suffix = "_" + frame_id.substr(frame_id.find_first_not_of('/'));
+        return MERGE_OUTPUT_t{frame_id, this->create_publisher<MergedCloudAdapter>(prefix + "pointcloud" + suffix, input_queue_size_), nullptr, {true, false}};
+    }
+    return MERGE_OUTPUT_t{frame_id,
+                          this->create_publisher<MergedCloudAdapter>(prefix + "pointcloud", input_queue_size_),
+                          this->create_publisher<sensor_msgs::msg::LaserScan>(prefix + "scan", input_queue_size_), {true, true}};
+}
+
+void laser_merger2::updateOutputDemand()
+{
+    auto subscribed = [](const auto &pub)
+    {
+        return pub->get_subscription_count() > 0 || pub->get_intra_process_subscription_count() > 0;
+    };
+
+    for(auto &group : groups_)
+    {
+        for(auto &output : group.outputs)
+        {
+            output.demand.cloud = subscribed(output.cloud_pub);
+            output.demand.scan = output.scan_pub && subscribed(output.scan_pub);
+        }
+    }
+    demandAge_ = 0;
+}
+
+void laser_merger2::laser_merge()
+{
+    rclcpp::Context::SharedPtr context = this->get_node_base_interface()->get_context();
+
+    std::string error;
+    if((realtime_priority_ > 0 || !cpu_affinity_.empty()) && !configureThread(realtime_priority_, cpu_affinity_, error))
+        RCLCPP_WARN(this->get_logger(), "Could not configure the merge thread, %s", error.c_str());
+    if(lock_memory_)
+        prefaultStack(256 * 1024);
+
+    while(rclcpp::ok(context) && alive_.load())
+    {
+        const bool partial = waitForMerge();
+        mergeCycle(partial);
+    }
+}
+
+void laser_merger2::mergeCycle(bool partial)
+{
+    // on the merging thread, whose heap the cycle allocates from, and outside the timed part
+    if(lock_memory_ && !prefaulted_)
+        prefaultMergeBuffers();
+
+    const auto start = std::chrono::steady_clock::now();
+    if(jitterPub_)
+        updateJitter();
+    // input changes are applied here, on the thread that owns the per-sensor state, never mid-merge
+    updateInputs();
+    mergeOnce(partial);
+    if(overload_control_)
+        updateLoad(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+void laser_merger2::prefaultMergeBuffers()
+{
+    prefaulted_ = true;
+
+    // the scan bins follow the output layout, known from the parameters
+    const size_t ranges_size = std::ceil((max_angle - min_angle) / angle_increment);
+    for(size_t w = 0; w < partialRanges_.size(); ++w)
+    {
+        partialRanges_[w].assign(ranges_size, 0.0f);
+        partialIntensities_[w].assign(ranges_size, 0.0f);
+    }
+    if(prefault_points_ <= 0)
+        return;
+
+    // buffers kept across cycles are grown once, resize writes every page
+    const size_t points = static_cast<size_t>(prefault_points_);
+    scratchX_.resize(std::max(scratchX_.size(), points));
+    scratchY_.resize(std::max(scratchY_.size(), points));
+    scratchZ_.resize(std::max(scratchZ_.size(), points));
+    if(voxelGrid_)
+        voxelGrid_->reserve(points, workers_->size());
+
+    // the per-sensor, merged and transformed clouds are allocated per cycle, from heap grown here
+    prefaultHeap(points * prefault_bytes_per_point);
+}
+
+void laser_merger2::updateJitter()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if(jitter_.has_last)
+    {
+        const double period = std::chrono::duration<double>(now - jitter_.last).count();
+        ++jitter_.count;
+        jitter_.sum += period;
+        jitter_.sum_sq += period * period;
+        jitter_.max_deviation = std::max(jitter_.max_deviation, std::fabs(period - 1.0 / rate_));
+    }
+    jitter_.last = now;
+    jitter_.has_last = true;
+
+    // about once per second
+    if(jitter_.count < rate_)
+        return;
+
+    const double mean = jitter_.sum / jitter_.count;
+    const double stddev = std::sqrt(std::max(0.0, jitter_.sum_sq / jitter_.count - mean * mean));
+
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = std::string(this->get_name()) + ": merge jitter";
+    status.level = diagnostic_msgs::msg::DiagnosticStatus::OK;
+    status.message = "merge cycle period over the last second";
+
+    diagnostic_msgs::msg::KeyValue entry;
+    entry.key = "period_mean";
+    entry.value = std::to_string(mean);
+    status.values.push_back(entry);
+    entry.key = "period_stddev";
+    entry.value = std::to_string(stddev);
+    status.values.push_back(entry);
+    entry.key = "max_deviation";
+    entry.value = std::to_string(jitter_.max_deviation);
+    status.values.push_back(entry);
+    jitterPub_->publish(status);
+
+    jitter_.count = 0;
+    jitter_.sum = 0.0;
+    jitter_.sum_sq = 0.0;
+    jitter_.max_deviation = 0.0;
+}
+
+void laser_merger2::updateLoad(double cycle_time)
+{
+    // escalate quickly, recover only after about two seconds of headroom so the levels do not oscillate
+    const int escalate_cycles = 3;
+    const int recover_cycles = std::max(1, static_cast<int>(2 * rate_));
+    const int max_level = 3;
+
+    load_.utilization = 0.8 * load_.utilization + 0.2 * cycle_time * rate_;
+    const int level = load_.level;
+    if(load_.utilization > overload_high_)
+    {
+        load_.low_cycles = 0;
+        if(++load_.high_cycles >= escalate_cycles && load_.level < max_level)
+            ++load_.level;
+    }
+    else if(load_.utilization < overload_low_)
+    {
+        load_.high_cycles = 0;
+        if(++load_.low_cycles >= recover_cycles && load_.level > 0)
+            --load_.level;
+    }
+    else
+    {
+        load_.high_cycles = 0;
+        load_.low_cycles = 0;
+    }
+
+    if(load_.level != level)
+    {
+        // every change has to prove itself over a full window again
+        load_.high_cycles = 0;
+        load_.low_cycles = 0;
+        loadStride_ = load_.level == 0 ? 1 : load_.level == 1 ? 2 : 4;
+        if(voxelGrid_)
+            voxelGrid_->setLeafSize(load_.level >= 2 ? 2 * voxel_leaf_size_ : voxel_leaf_size_);
+        RCLCPP_WARN(this->get_logger(), "Merge load %.0f%% of the %.1f Hz budget, degradation level %d -> %d",
+                    load_.utilization * 100.0, rate_, level, load_.level);
+    }
+
+    if(load_.level != level || ++load_.report_age >= rate_)
+    {
+        load_.report_age = 0;
+        publishLoad(cycle_time);
+    }
+}
+
+void laser_merger2::publishLoad(double cycle_time)
+{
+    static const char *actions[] = {"nominal", "decimation x2", "decimation x4, voxel leaf x2", "decimation x4, voxel leaf x2, cloud output skipped"};
+
+    diagnostic_msgs::msg::DiagnosticStatus status;
+    status.name = std::string(this->get_name()) + ": merge load";
+    status.level = load_.level == 0 ? diagnostic_msgs::msg::DiagnosticStatus::OK : diagnostic_msgs::msg::DiagnosticStatus::WARN;
+    status.message = actions[load_.level];
+
+    diagnostic_msgs::msg::KeyValue entry;
+    entry.key = "level";
+    entry.value = std::to_string(load_.level);
+    status.values.push_back(entry);
+    entry.key = "utilization";
+    entry.value = std::to_string(load_.utilization);
+    status.values.push_back(entry);
+    entry.key = "cycle_time";
+    entry.value = std::to_string(cycle_time);
+    status.values.push_back(entry);
+    entry.key = "budget";
+    entry.value = std::to_string(1.0 / rate_);
+    status.values.push_back(entry);
+    loadPub_->publish(status);
+}
+
+void laser_merger2::mergeOnce(bool partial)
+{
+    // matching can complete slightly after the graph event, so also refresh about once per second
+    if(graphEvent_->check_and_clear() || ++demandAge_ >= rate_)
+        updateOutputDemand();
+
+    std::vector<SENSOR_INPUT_t> inputs = selectInputs(partial);
+    inputs.erase(std::remove_if(inputs.begin(), inputs.end(), [this](SENSOR_INPUT_t &input)
+        {
+            return !resolveLatest(input);
+        }
+    ), inputs.end());
+
+    // nobody listens, drop the inputs without converting them
+    bool demand = false;
+    for(const auto &group : groups_)
+    {
+        for(const auto &output : group.outputs)
+            demand |= output.demand.cloud || output.demand.scan;
+    }
+    if(!demand)
+    {
+        return;
+    }
+
+    // new inputs replace the cached ones, cached ones are reused until sensor_max_age
+    const std::vector<size_t> active = activeSensors(inputs);
+    if(active.empty())
+    {
+        return;
+    }
+
+    int64_t stamp = sensors_[active.front()].last.stamp;
+    for(size_t s : active)
+        stamp = std::max(stamp, sensors_[s].last.stamp);
+    laserTime = rclcpp::Time(stamp, RCL_ROS_TIME);
+
+    // bring every new input to the target frame as it was at the merge stamp
+    bool frames_changed = false;
+    for(size_t s : active)
+    {
+        SENSOR_t &sensor = sensors_[s];
+        // reused points follow the target frame to the new stamp, or are converted again when its motion is unknown
+        if(sensor.converted && (motion_compensation_ == "none" || rebaseCache(sensor)))
+            continue;
+        sensor.converted = false;
+
+        compensateMotion(sensor.last);
+        frames_changed |= sensor.frame_id != inputFrame(sensor.last);
+        sensor.frame_id = inputFrame(sensor.last);
+    }
+    if(publish_sensor_id_ && frames_changed)
+        publishSensorIds();
+    if(mergeStatusPub_)
+        publishMergeStatus(inputs);
+
+    for(auto &group : groups_)
+        mergeGroup(group, active, stamp);
+}
+
+void laser_merger2::convertSensor(SENSOR_t &sensor)
+{
+    if(sensor.converted)
+        return;
+
+    sensor.points.clear();
+    sensor.points.has_time = publish_point_time_;
+    sensor.points.has_sensor_id = publish_sensor_id_;
+    if(sensor.last.scan)
+        scantoPointXYZ(sensor.last, sensor.points);
+    else
+        pointCloudtoPointXYZ(sensor.last, sensor.points);
+    // cached with the converted points, reused inputs are not filtered twice
+    if(footprint_)
+        footprint_->filter(sensor.points, *workers_);
+    sensor.converted = true;
+    sensor.reference = laserTime.nanoseconds();
+}
+
+bool laser_merger2::rebaseCache(SENSOR_t &sensor)
+{
+    const int64_t reference = laserTime.nanoseconds();
+    if(sensor.reference == reference)
+        return true;
+
+    // target frame at the old merge stamp expressed in the target frame at the new one
+    double x, y, yaw;
+    if(!targetMotion(sensor.reference, x, y, yaw))
+        return false;
+
+    const float c = std::cos(yaw), s = std::sin(yaw);
+    const float m[12] = {c, -s, 0.0f, static_cast<float>(x),
+                         s, c, 0.0f, static_cast<float>(y),
+                         0.0f, 0.0f, 1.0f, 0.0f};
+    MergedCloud &points = sensor.points;
+    scratchX_.resize(points.size());
+    scratchY_.resize(points.size());
+    scratchZ_.resize(points.size());
+    workers_->parallelFor(points.size(), [&](size_t begin, size_t end, size_t)
+        {
+            rigidTransform(points.x.data(), points.y.data(), points.z.data(), scratchX_.data(), scratchY_.data(), scratchZ_.data(), begin, end, m);
+        }
+    );
+    points.x.swap(scratchX_);
+    points.y.swap(scratchY_);
+    points.z.swap(scratchZ_);
+    sensor.reference = reference;
+    return true;
+}
+
+bool laser_merger2::transformPoints(const MergedCloud &points, MergedCloud &out, const std::string &frame_id)
+{
+    // never wait on the merge thread: the newest merge stamp is usually ahead of odom, so fall back to the
+    // latest transform and skip the output for this cycle when there is none at all
+    geometry_msgs::msg::TransformStamped transform;
+    try
+    {
+        const tf2::TimePoint time(std::chrono::nanoseconds(laserTime.nanoseconds()));
+        if (stamped_tf_ && tf2_->canTransform(frame_id, target_frame_, time))
+            transform = tf2_->lookupTransform(frame_id, target_frame_, time);
+        else
+            transform = tf2_->lookupTransform(frame_id, target_frame_, tf2::TimePointZero);
+    }
+    catch (const tf2::TransformException &ex)
+    {
+        RCLCPP_WARN_THROTTLE(this->get_logger(), *this->get_clock(), 1000, "Skipping the %s output, no transform from %s: %s",
+                             frame_id.c_str(), target_frame_.c_str(), ex.what());
+        return false;
+    }
+
+    const auto &rotation = transform.transform.rotation;
+    const auto &translation = transform.transform.translation;
+    const Eigen::Matrix3f R = Eigen::Quaternionf(rotation.w, rotation.x, rotation.y, rotation.z).toRotationMatrix();
+    const float m[12] = {R(0, 0), R(0, 1), R(0, 2), static_cast<float>(translation.x),
+                         R(1, 0), R(1, 1), R(1, 2), static_cast<float>(translation.y),
+                         R(2, 0), R(2, 1), R(2, 2), static_cast<float>(translation.z)};
+
+    // a copy only shares the columns the transform does not touch
+    const bool in_place = &out == &points;
+    if (!in_place)
+    {
+        out.header = points.header;
+        out.has_intensity = points.has_intensity;
+        out.has_time = points.has_time;
+        out.has_sensor_id = points.has_sensor_id;
+        out.resize(points.size());
+        out.intensity = points.intensity;
+        out.t = points.t;
+        out.sensor_id = points.sensor_id;
+    }
+
+    // the kernel never writes the columns it reads, in place goes through scratch columns swapped in afterwards
+    std::vector<float> &x = in_place ? scratchX_ : out.x;
+    std::vector<float> &y = in_place ? scratchY_ : out.y;
+    std::vector<float> &z = in_place ? scratchZ_ : out.z;
+    x.resize(points.size());
+    y.resize(points.size());
+    z.resize(points.size());
+
+    // every worker takes a contiguous slice
+    workers_->parallelFor(points.size(), [&](size_t begin, size_t end, size_t)
+        {
+            rigidTransform(points.x.data(), points.y.data(), points.z.data(), x.data(), y.data(), z.data(), begin, end, m);
+        }
+    );
+
+    if (in_place)
+    {
+        out.x.swap(scratchX_);
+        out.y.swap(scratchY_);
+        out.z.swap(scratchZ_);
+    }
+    return true;
+}
+
+void laser_merger2::mergeGroup(MERGE_GROUP_t &group, const std::vector<size_t> &active, int64_t stamp)
+{
+    // the last overload level drops the cloud output, the scan keeps being produced
+    const bool cloud_allowed = load_.level < 3;
+    auto wanted = [cloud_allowed](const MERGE_OUTPUT_t &output)
+    {
+        return (output.demand.cloud && cloud_allowed) || output.demand.scan;
+    };
+
+    std::vector<size_t> members;
+    bool scans_only = true;
+    for(size_t s : active)
+    {
+        if(!group.inputs[s])
+            continue;
+        members.push_back(s);
+        scans_only &= sensors_[s].last.scan != nullptr;
+    }
+    if(members.empty())
+        return;
+
+    // scan-only inputs feeding a scan-only output skip the intermediate point buffer, it has no z to crop on
+    const bool direct_scan = scans_only && !crop_.enabled && !footprint_;
+    std::vector<SENSOR_INPUT_t> scans;
+    std::vector<size_t> buffered;
+    for(size_t o = 0; o < group.outputs.size(); ++o)
+    {
+        const MERGE_OUTPUT_t &output = group.outputs[o];
+        if(!wanted(output))
+            continue;
+        if(!direct_scan || (output.demand.cloud && cloud_allowed) || output.frame_id != target_frame_)
+        {
+            buffered.push_back(o);
+            continue;
+        }
+
+        if(scans.empty())
+        {
+            for(size_t s : members)
+                scans.push_back(sensors_[s].last);
+        }
+        projectScansDirect(scans, output);
+    }
+    if(buffered.empty())
+        return;
+
+    // convert new inputs to current base frame, then gather every active sensor of the group
+    MergedCloud points;
+    points.has_time = publish_point_time_;
+    points.has_sensor_id = publish_sensor_id_;
+    for(size_t s : members)
+    {
+        SENSOR_t &sensor = sensors_[s];
+        convertSensor(sensor);
+        points.append(sensor.points, (sensor.last.stamp - stamp) * 1e-9);
+    }
+    if (points.empty())
+        return;
+
+    RCLCPP_DEBUG(this->get_logger(), "Publishing %ld merged points", points.size());
+    // the merged buffer is built once, every output frame but the last one works on a transformed copy
+    // and the last one transforms and publishes the buffer itself
+    for(size_t b = 0; b < buffered.size(); ++b)
+    {
+        const MERGE_OUTPUT_t &output = group.outputs[buffered[b]];
+        const bool last = b + 1 == buffered.size();
+        MergedCloud copy;
+        MergedCloud &frame_points = last ? points : copy;
+        if(output.frame_id != target_frame_)
+        {
+            if(!transformPoints(points, frame_points, output.frame_id))
+                continue;
+        }
+        else if(!last)
+        {
+            frame_points = points;
+        }
+        publishOutput(frame_points, output);
+    }
+}
+
+void laser_merger2::publishOutput(MergedCloud &points, const MERGE_OUTPUT_t &output)
+{
+    // the scan reads the buffer before the cloud publisher takes ownership of it
+    if (output.demand.scan)
+        ConvertLaserScan(points, output);
+    if (output.demand.cloud && load_.level < 3)
+    {
+        // overlapping views only get thinned in the 3D output, the scan keeps the closest returns
+        if (voxelGrid_)
+            voxelGrid_->filter(points, *workers_);
+        ConvertPointCloud2(points, output);
+    }
+}
+
+#include "rclcpp_components/register_node_macro.hpp"
+RCLCPP_COMPONENTS_REGISTER_NODE(laser_merger2)
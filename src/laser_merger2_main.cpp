@@ -3,7 +3,10 @@
 int main(int argc, char * argv[])
 {
   rclcpp::init(argc, argv);
-  rclcpp::spin(std::make_shared<laser_merger2>());
+  // the merge timer has its own callback group, it only runs in parallel with the subscriptions on a multi-threaded executor
+  rclcpp::executors::MultiThreadedExecutor executor;
+  executor.add_node(std::make_shared<laser_merger2>());
+  executor.spin();
   rclcpp::shutdown();
   return 0;
 }
\ No newline at end of file
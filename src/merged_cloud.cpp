@@ -0,0 +1,104 @@
+#include <laser_merger2/merged_cloud.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+void addField(sensor_msgs::msg::PointCloud2 &cloud, const std::string &name, uint8_t datatype, uint32_t size)
+{
+    sensor_msgs::msg::PointField field;
+    field.name = name;
+    field.offset = cloud.point_step;
+    field.datatype = datatype;
+    field.count = 1;
+    cloud.fields.push_back(field);
+    cloud.point_step += size;
+}
+
+// Scatter one SoA column into its interleaved PointCloud2 slot
+template<typename T>
+void writeColumn(sensor_msgs::msg::PointCloud2 &cloud, uint32_t offset, const std::vector<T> &column)
+{
+    uint8_t *out = cloud.data.data() + offset;
+    for(size_t i = 0; i < column.size(); ++i, out += cloud.point_step)
+        std::memcpy(out, &column[i], sizeof(T));
+}
+
+// Gather one PointCloud2 field into an SoA column, false when the field is missing
+template<typename T>
+bool readColumn(const sensor_msgs::msg::PointCloud2 &cloud, const std::string &name, uint8_t datatype, std::vector<T> &column)
+{
+    auto field = std::find_if(cloud.fields.begin(), cloud.fields.end(), [&](const auto &f) {
+        return f.name == name && f.datatype == datatype;
+    });
+    if(field == cloud.fields.end())
+        return false;
+
+    column.resize(static_cast<size_t>(cloud.width) * cloud.height);
+    for(size_t i = 0; i < column.size(); ++i)
+    {
+        const size_t row = i / cloud.width;
+        const size_t col = i % cloud.width;
+        std::memcpy(&column[i], cloud.data.data() + row * cloud.row_step + col * cloud.point_step + field->offset, sizeof(T));
+    }
+    return true;
+}
+
+}  // namespace
+
+void MergedCloudAdapter::convert_to_ros_message(const custom_type &source, ros_message_type &destination)
+{
+    destination.header = source.header;
+    destination.height = 1;
+    destination.width = source.size();
+    destination.is_bigendian = false;
+    destination.is_dense = true;
+    destination.fields.clear();
+    destination.point_step = 0;
+
+    const auto FLOAT32 = sensor_msgs::msg::PointField::FLOAT32;
+    addField(destination, "x", FLOAT32, sizeof(float));
+    addField(destination, "y", FLOAT32, sizeof(float));
+    addField(destination, "z", FLOAT32, sizeof(float));
+    if (source.has_intensity)
+        addField(destination, "intensity", FLOAT32, sizeof(float));
+    if (source.has_time)
+        addField(destination, "t", FLOAT32, sizeof(float));
+    if (source.has_sensor_id)
+        addField(destination, "sensor_id", sensor_msgs::msg::PointField::UINT8, sizeof(uint8_t));
+
+    // keep every point 4-byte aligned for consumers that map it onto a struct
+    destination.point_step = (destination.point_step + 3) & ~3u;
+    destination.row_step = destination.point_step * destination.width;
+    destination.data.resize(destination.row_step);
+
+    size_t field = 0;
+    writeColumn(destination, destination.fields[field++].offset, source.x);
+    writeColumn(destination, destination.fields[field++].offset, source.y);
+    writeColumn(destination, destination.fields[field++].offset, source.z);
+    if (source.has_intensity)
+        writeColumn(destination, destination.fields[field++].offset, source.intensity);
+    if (source.has_time)
+        writeColumn(destination, destination.fields[field++].offset, source.t);
+    if (source.has_sensor_id)
+        writeColumn(destination, destination.fields[field++].offset, source.sensor_id);
+}
+
+void MergedCloudAdapter::convert_to_custom(const ros_message_type &source, custom_type &destination)
+{
+    const auto FLOAT32 = sensor_msgs::msg::PointField::FLOAT32;
+
+    destination.clear();
+    destination.header = source.header;
+    readColumn(source, "x", FLOAT32, destination.x);
+    readColumn(source, "y", FLOAT32, destination.y);
+    readColumn(source, "z", FLOAT32, destination.z);
+
+    destination.has_intensity = readColumn(source, "intensity", FLOAT32, destination.intensity);
+    if (!destination.has_intensity)
+        destination.intensity.assign(destination.size(), 0);
+    destination.has_time = readColumn(source, "t", FLOAT32, destination.t);
+    destination.has_sensor_id = readColumn(source, "sensor_id", sensor_msgs::msg::PointField::UINT8, destination.sensor_id);
+}
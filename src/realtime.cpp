@@ -0,0 +1,76 @@
+#include <laser_merger2/realtime.h>
+
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <alloca.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+bool configureThread(int priority, const std::vector<int64_t> &cpus, std::string &error)
+{
+    if(!cpus.empty())
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int64_t cpu : cpus)
+        {
+            if(cpu >= 0 && cpu < CPU_SETSIZE)
+                CPU_SET(static_cast<int>(cpu), &set);
+        }
+
+        const int result = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if(result != 0)
+        {
+            error = std::string("cpu affinity: ") + std::strerror(result);
+            return false;
+        }
+    }
+
+    if(priority > 0)
+    {
+        sched_param param{};
+        param.sched_priority = priority;
+        const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if(result != 0)
+        {
+            error = std::string("SCHED_FIFO: ") + std::strerror(result);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool lockMemory(std::string &error)
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        error = std::string("mlockall: ") + std::strerror(errno);
+        return false;
+    }
+
+    // large blocks would otherwise be mmapped and unmapped again on every cycle
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_TRIM_THRESHOLD, -1);
+    return true;
+}
+
+void prefaultStack(size_t size)
+{
+    volatile char *stack = static_cast<volatile char *>(alloca(size));
+    for(size_t i = 0; i < size; i += 4096)
+        stack[i] = 0;
+}
+
+void prefaultHeap(size_t size)
+{
+    volatile char *block = static_cast<volatile char *>(std::malloc(size));
+    if(block == nullptr)
+        return;
+    for(size_t i = 0; i < size; i += 4096)
+        block[i] = 0;
+    std::free(const_cast<char *>(block));
+}
@@ -0,0 +1,121 @@
+#include <laser_merger2/sync_matcher.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace
+{
+// k-way merge over the queues: the heads sit in a min-heap by stamp then sensor, and the newest head is
+// tracked as it only grows when a head advances
+class Sweep
+{
+  public:
+    explicit Sweep(const std::vector<std::vector<int64_t>> &stamps)
+        : stamps_(stamps), heads_(stamps.size(), 0), newest_(std::numeric_limits<int64_t>::min())
+    {
+        for(size_t s = 0; s < stamps_.size(); ++s)
+        {
+            heap_.emplace(stamps_[s][0], s);
+            newest_ = std::max(newest_, stamps_[s][0]);
+        }
+    }
+
+    int64_t spread() const { return newest_ - heap_.top().first; }
+    const std::vector<size_t> &heads() const { return heads_; }
+
+    // only advancing the oldest head can tighten the set, false once its sensor has no newer stamp
+    bool advance()
+    {
+        const size_t oldest = heap_.top().second;
+        if(heads_[oldest] + 1 == stamps_[oldest].size())
+            return false;
+
+        const int64_t stamp = stamps_[oldest][++heads_[oldest]];
+        heap_.pop();
+        heap_.emplace(stamp, oldest);
+        newest_ = std::max(newest_, stamp);
+        return true;
+    }
+
+  private:
+    typedef std::pair<int64_t, size_t> Head;   // stamp, sensor
+
+    const std::vector<std::vector<int64_t>> &stamps_;
+    std::vector<size_t> heads_;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap_;
+    int64_t newest_;
+};
+}  // namespace
+
+bool matchTightestSet(const std::vector<std::vector<int64_t>> &stamps, int64_t window, std::vector<size_t> &picks)
+{
+    if(stamps.empty())
+        return false;
+
+    for(const auto &queue : stamps)
+    {
+        if(queue.empty())
+            return false;
+    }
+
+    Sweep sweep(stamps);
+    int64_t best_spread = std::numeric_limits<int64_t>::max();
+    size_t best_step = 0;
+    for(size_t step = 0; ; ++step)
+    {
+        // <= prefers the most recent of equally tight sets
+        if(sweep.spread() <= best_spread)
+        {
+            best_spread = sweep.spread();
+            best_step = step;
+        }
+        if(!sweep.advance())
+            break;
+    }
+
+    // replaying to the best step costs another sweep, copying the heads on every improvement would cost
+    // O(sensors) per step
+    Sweep replay(stamps);
+    for(size_t step = 0; step < best_step; ++step)
+        replay.advance();
+    picks = replay.heads();
+
+    return best_spread <= window;
+}
+
+constexpr int ArrivalMonitor::stall_periods;
+constexpr int64_t ArrivalMonitor::startup_grace;
+
+void ArrivalMonitor::reset(int64_t now)
+{
+    last_ = now;
+    period_ = 0;
+    has_last_ = false;
+}
+
+void ArrivalMonitor::arrived(int64_t now)
+{
+    const int64_t interval = now - last_;
+    if(has_last_ && interval > 0)
+    {
+        // a gap after a stall is not a period, it would hide the next one
+        if(period_ == 0)
+            period_ = interval;
+        else if(interval <= stall_periods * period_)
+            period_ += (interval - period_) / 8;
+    }
+    last_ = now;
+    has_last_ = true;
+}
+
+bool ArrivalMonitor::stalled(int64_t now, int64_t fallback_period, int64_t window) const
+{
+    if(period_ > 0)
+        return now - last_ > stall_periods * period_ + window;
+    if(fallback_period <= 0)
+        return false;
+    return now - last_ > std::max(stall_periods * fallback_period + window, startup_grace);
+}
@@ -0,0 +1,267 @@
+#include <laser_merger2/voxel_grid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+// 21 bits per axis, the top bit stays clear so ~0 never collides with a leaf
+constexpr int64_t key_offset = int64_t(1) << 20;
+constexpr uint64_t key_mask = (uint64_t(1) << 21) - 1;
+constexpr uint64_t invalid_key = ~uint64_t(0);
+
+inline uint64_t leafKey(float x, float y, float z, float inv_leaf)
+{
+    const float fx = std::floor(x * inv_leaf);
+    const float fy = std::floor(y * inv_leaf);
+    const float fz = std::floor(z * inv_leaf);
+    // also rejects NaN, every comparison with it is false
+    const float limit = static_cast<float>(key_offset);
+    if(!(fx >= -limit && fx < limit && fy >= -limit && fy < limit && fz >= -limit && fz < limit))
+        return invalid_key;
+
+    return (static_cast<uint64_t>(static_cast<int64_t>(fx) + key_offset) & key_mask) << 42
+        | (static_cast<uint64_t>(static_cast<int64_t>(fy) + key_offset) & key_mask) << 21
+        | (static_cast<uint64_t>(static_cast<int64_t>(fz) + key_offset) & key_mask);
+}
+
+// splitmix64 finalizer, neighbouring leaves land far apart
+inline uint64_t leafHash(uint64_t key)
+{
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    return key ^ (key >> 31);
+}
+
+// map the upper hash bits onto [0, workers) without a division, the lower bits pick the slot
+inline size_t leafOwner(uint64_t hash, size_t workers)
+{
+    return static_cast<size_t>(((hash >> 32) * workers) >> 32);
+}
+}  // namespace
+
+VoxelGrid::VoxelGrid(float leaf_size, Policy policy)
+    : inv_leaf_(1.0f / leaf_size), policy_(policy)
+{
+}
+
+void VoxelGrid::filter(MergedCloud &points, WorkerPool &workers)
+{
+    const size_t count = points.size();
+    if(count == 0)
+        return;
+
+    const size_t worker_count = workers.size();
+    keys_.resize(count);
+    hashes_.resize(count);
+    owners_.resize(count);
+    order_.resize(count);
+    counts_.assign(worker_count * worker_count, 0);
+    tables_.resize(worker_count);
+
+    // fixed slices so the count and scatter passes agree, slice s counts its points per owner in counts_[s * workers + owner]
+    auto slice = [count, worker_count](size_t s) { return count * s / worker_count; };
+    workers.parallelFor(worker_count, [&](size_t begin, size_t end, size_t)
+        {
+            for(size_t s = begin; s < end; ++s)
+            {
+                size_t *counts = &counts_[s * worker_count];
+                for(size_t i = slice(s); i < slice(s + 1); ++i)
+                {
+                    const uint64_t key = leafKey(points.x[i], points.y[i], points.z[i], inv_leaf_);
+                    const uint64_t hash = leafHash(key);
+                    const size_t owner = key == invalid_key ? worker_count : leafOwner(hash, worker_count);
+                    keys_[i] = key;
+                    hashes_[i] = hash;
+                    owners_[i] = static_cast<uint32_t>(owner);
+                    if(owner < worker_count)
+                        ++counts[owner];
+                }
+            }
+        }
+    );
+
+    // exclusive prefix sum in owner major order, each owner's indices stay in slice, hence merge, order
+    std::vector<size_t> owned(worker_count + 1, 0);
+    size_t offset = 0;
+    for(size_t owner = 0; owner < worker_count; ++owner)
+    {
+        owned[owner] = offset;
+        for(size_t s = 0; s < worker_count; ++s)
+        {
+            const size_t n = counts_[s * worker_count + owner];
+            counts_[s * worker_count + owner] = offset;
+            offset += n;
+        }
+    }
+    owned[worker_count] = offset;
+
+    workers.parallelFor(worker_count, [&](size_t begin, size_t end, size_t)
+        {
+            for(size_t s = begin; s < end; ++s)
+            {
+                size_t *next = &counts_[s * worker_count];
+                for(size_t i = slice(s); i < slice(s + 1); ++i)
+                {
+                    if(owners_[i] < worker_count)
+                        order_[next[owners_[i]]++] = static_cast<uint32_t>(i);
+                }
+            }
+        }
+    );
+
+    workers.parallelFor(worker_count, [&](size_t begin, size_t end, size_t)
+        {
+            for(size_t t = begin; t < end; ++t)
+                bin(points, tables_[t], order_.data() + owned[t], owned[t + 1] - owned[t]);
+        }
+    );
+
+    std::vector<size_t> offsets(worker_count + 1, 0);
+    for(size_t t = 0; t < worker_count; ++t)
+        offsets[t + 1] = offsets[t] + tables_[t].first.size();
+    const size_t total = offsets.back();
+
+    out_.clear();
+    out_.header = points.header;
+    out_.has_intensity = points.has_intensity;
+    out_.has_time = points.has_time;
+    out_.has_sensor_id = points.has_sensor_id;
+    out_.x.resize(total);
+    out_.y.resize(total);
+    out_.z.resize(total);
+    out_.intensity.resize(total);
+    if(out_.has_time)
+        out_.t.resize(total);
+    if(out_.has_sensor_id)
+        out_.sensor_id.resize(total);
+
+    workers.parallelFor(worker_count, [&](size_t begin, size_t end, size_t)
+        {
+            for(size_t t = begin; t < end; ++t)
+                emit(points, tables_[t], offsets[t], out_);
+        }
+    );
+
+    // the input buffers become next cycle's output buffers
+    std::swap(points, out_);
+}
+
+void VoxelGrid::reserve(size_t points, size_t workers)
+{
+    keys_.resize(std::max(keys_.size(), points));
+    hashes_.resize(std::max(hashes_.size(), points));
+    owners_.resize(std::max(owners_.size(), points));
+    order_.resize(std::max(order_.size(), points));
+    out_.reserve(points);
+
+    // hashing spreads the leaves evenly, a quarter more leaves room for an unlucky owner
+    workers = std::max<size_t>(workers, 1);
+    const size_t per_table = points / workers + points / workers / 4;
+    tables_.resize(std::max(tables_.size(), workers));
+    for(auto &table : tables_)
+    {
+        size_t capacity = 64;
+        while(capacity < 2 * per_table)
+            capacity <<= 1;
+        if(table.slots.size() < capacity)
+        {
+            table.slots.assign(capacity, SLOT_t{0, 0, 0});
+            table.current = 0;
+        }
+        table.first.resize(per_table);
+        table.sums.resize(per_table);
+    }
+}
+
+void VoxelGrid::bin(const MergedCloud &points, TABLE_t &table, const uint32_t *owned, size_t count)
+{
+    // keep the load factor at or below one half
+    size_t capacity = 64;
+    while(capacity < 2 * count)
+        capacity <<= 1;
+    if(table.slots.size() < capacity)
+    {
+        table.slots.assign(capacity, SLOT_t{0, 0, 0});
+        table.current = 0;
+    }
+    if(++table.current == 0)
+    {
+        for(auto &slot : table.slots)
+            slot.generation = 0;
+        table.current = 1;
+    }
+
+    const bool centroid = policy_ == Policy::Centroid;
+    table.first.clear();
+    table.sums.clear();
+
+    const uint64_t mask = table.slots.size() - 1;
+    for(size_t o = 0; o < count; ++o)
+    {
+        const uint32_t i = owned[o];
+        const uint64_t key = keys_[i];
+        uint64_t index = hashes_[i] & mask;
+        while(table.slots[index].generation == table.current && table.slots[index].key != key)
+            index = (index + 1) & mask;
+
+        SLOT_t &slot = table.slots[index];
+        if(slot.generation != table.current)
+        {
+            slot.generation = table.current;
+            slot.key = key;
+            slot.cell = static_cast<uint32_t>(table.first.size());
+            table.first.push_back(i);
+            if(!centroid)
+                continue;
+            table.sums.push_back(SUM_t{0.0, 0.0, 0.0, 0.0, 0.0, 0});
+        }
+        else if(!centroid)
+        {
+            continue;
+        }
+
+        SUM_t &sum = table.sums[slot.cell];
+        ++sum.count;
+        sum.x += points.x[i];
+        sum.y += points.y[i];
+        sum.z += points.z[i];
+        sum.intensity += points.intensity[i];
+        if(points.has_time)
+            sum.t += points.t[i];
+    }
+}
+
+void VoxelGrid::emit(const MergedCloud &points, const TABLE_t &table, size_t offset, MergedCloud &out) const
+{
+    for(size_t c = 0; c < table.first.size(); ++c)
+    {
+        const size_t o = offset + c;
+        const uint32_t f = table.first[c];
+        if(out.has_sensor_id)
+            out.sensor_id[o] = points.sensor_id[f];
+
+        if(policy_ == Policy::First)
+        {
+            out.x[o] = points.x[f];
+            out.y[o] = points.y[f];
+            out.z[o] = points.z[f];
+            out.intensity[o] = points.intensity[f];
+            if(out.has_time)
+                out.t[o] = points.t[f];
+            continue;
+        }
+
+        const SUM_t &sum = table.sums[c];
+        const double inv_count = 1.0 / sum.count;
+        out.x[o] = static_cast<float>(sum.x * inv_count);
+        out.y[o] = static_cast<float>(sum.y * inv_count);
+        out.z[o] = static_cast<float>(sum.z * inv_count);
+        out.intensity[o] = static_cast<float>(sum.intensity * inv_count);
+        if(out.has_time)
+            out.t[o] = static_cast<float>(sum.t * inv_count);
+    }
+}
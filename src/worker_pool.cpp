@@ -0,0 +1,80 @@
+#include <laser_merger2/worker_pool.h>
+
+WorkerPool::WorkerPool(size_t workers, const Setup &setup)
+{
+    for(size_t i = 1; i < workers; ++i)
+    {
+        threads_.emplace_back([this, i, setup]
+            {
+                if(setup)
+                    setup(i);
+                run(i);
+            }
+        );
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+
+    for(auto &thread : threads_)
+        thread.join();
+}
+
+void WorkerPool::parallelFor(size_t count, const Task &task)
+{
+    if(threads_.empty() || count < size())
+    {
+        task(0, count, 0);
+        return;
+    }
+
+    std::lock_guard<std::mutex> call(callMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        pending_ = threads_.size();
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    task(0, count / size(), 0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+}
+
+void WorkerPool::run(size_t worker)
+{
+    size_t seen = 0;
+    while(true)
+    {
+        const Task *task;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+            if(stop_)
+                return;
+
+            seen = generation_;
+            task = task_;
+            count = count_;
+        }
+
+        (*task)(worker * count / size(), (worker + 1) * count / size(), worker);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(--pending_ == 0)
+                done_.notify_one();
+        }
+    }
+}
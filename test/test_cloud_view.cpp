@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+
+#include "laser_merger2/cloud_view.h"
+#include "rclcpp/serialization.hpp"
+#include "rclcpp/serialized_message.hpp"
+
+namespace
+{
+sensor_msgs::msg::PointField makeField(const std::string &name, uint32_t offset, uint8_t datatype)
+{
+    sensor_msgs::msg::PointField field;
+    field.name = name;
+    field.offset = offset;
+    field.datatype = datatype;
+    field.count = 1;
+    return field;
+}
+
+// 2 x 3 organized cloud with float coordinates, a ring and a FLOAT64 time, rows padded past the points
+sensor_msgs::msg::PointCloud2 makeCloud(const std::string &frame_id)
+{
+    sensor_msgs::msg::PointCloud2 cloud;
+    cloud.header.stamp.sec = 1700000000;
+    cloud.header.stamp.nanosec = 123456789;
+    cloud.header.frame_id = frame_id;
+    cloud.height = 2;
+    cloud.width = 3;
+    cloud.fields.push_back(makeField("x", 0, sensor_msgs::msg::PointField::FLOAT32));
+    cloud.fields.push_back(makeField("y", 4, sensor_msgs::msg::PointField::FLOAT32));
+    cloud.fields.push_back(makeField("z", 8, sensor_msgs::msg::PointField::FLOAT32));
+    cloud.fields.push_back(makeField("intensity", 12, sensor_msgs::msg::PointField::FLOAT32));
+    cloud.fields.push_back(makeField("ring", 16, sensor_msgs::msg::PointField::UINT16));
+    cloud.fields.push_back(makeField("time", 24, sensor_msgs::msg::PointField::FLOAT64));
+    cloud.is_bigendian = false;
+    cloud.point_step = 32;
+    cloud.row_step = cloud.width * cloud.point_step + 8;
+    cloud.data.resize(cloud.height * cloud.row_step);
+    for(size_t i = 0; i < cloud.data.size(); ++i)
+        cloud.data[i] = static_cast<uint8_t>(i * 7 + 1);
+    cloud.is_dense = true;
+    return cloud;
+}
+
+rclcpp::SerializedMessage serialize(const sensor_msgs::msg::PointCloud2 &cloud)
+{
+    rclcpp::Serialization<sensor_msgs::msg::PointCloud2> serializer;
+    rclcpp::SerializedMessage serialized;
+    serializer.serialize_message(&cloud, &serialized);
+    return serialized;
+}
+
+void expectSameView(const CloudView &expected, const CloudView &view)
+{
+    EXPECT_EQ(expected.header.stamp.sec, view.header.stamp.sec);
+    EXPECT_EQ(expected.header.stamp.nanosec, view.header.stamp.nanosec);
+    EXPECT_EQ(expected.header.frame_id, view.header.frame_id);
+    EXPECT_EQ(expected.height, view.height);
+    EXPECT_EQ(expected.width, view.width);
+    EXPECT_EQ(expected.point_step, view.point_step);
+    EXPECT_EQ(expected.row_step, view.row_step);
+    EXPECT_EQ(expected.is_bigendian, view.is_bigendian);
+
+    ASSERT_EQ(expected.fields.size(), view.fields.size());
+    for(size_t f = 0; f < expected.fields.size(); ++f)
+    {
+        EXPECT_EQ(expected.fields[f].name, view.fields[f].name);
+        EXPECT_EQ(expected.fields[f].offset, view.fields[f].offset);
+        EXPECT_EQ(expected.fields[f].datatype, view.fields[f].datatype);
+        EXPECT_EQ(expected.fields[f].count, view.fields[f].count);
+    }
+
+    ASSERT_EQ(expected.data_size, view.data_size);
+    if(expected.data_size > 0)
+    {
+        EXPECT_EQ(0, std::memcmp(expected.data, view.data, expected.data_size));
+    }
+}
+}  // namespace
+
+TEST(CloudView, FromCdrMatchesFromMessage)
+{
+    const auto cloud = makeCloud("lidar_front");
+    const auto serialized = serialize(cloud);
+
+    CloudView view;
+    ASSERT_TRUE(view.fromCdr(serialized));
+    expectSameView(CloudView::fromMessage(cloud), view);
+
+    ASSERT_NE(view.field("time"), nullptr);
+    EXPECT_EQ(view.field("time")->offset, 24u);
+    EXPECT_EQ(view.field("missing"), nullptr);
+}
+
+TEST(CloudView, FromCdrEmptyFrameId)
+{
+    const auto cloud = makeCloud("");
+    const auto serialized = serialize(cloud);
+
+    CloudView view;
+    ASSERT_TRUE(view.fromCdr(serialized));
+    expectSameView(CloudView::fromMessage(cloud), view);
+}
+
+TEST(CloudView, FromCdrEmptyCloud)
+{
+    sensor_msgs::msg::PointCloud2 cloud;
+    cloud.header.frame_id = "base_link";
+    const auto serialized = serialize(cloud);
+
+    CloudView view;
+    ASSERT_TRUE(view.fromCdr(serialized));
+    expectSameView(CloudView::fromMessage(cloud), view);
+    EXPECT_EQ(view.size(), 0u);
+}
+
+TEST(CloudView, FromCdrRejectsTruncatedBuffer)
+{
+    const auto serialized = serialize(makeCloud("lidar_front"));
+    const rcl_serialized_message_t &raw = serialized.get_rcl_serialized_message();
+
+    CloudView full;
+    ASSERT_TRUE(full.fromCdr(serialized));
+    // fromCdr stops after the point data, only is_dense follows it
+    const size_t data_end = static_cast<size_t>(full.data - raw.buffer) + full.data_size;
+    ASSERT_LE(data_end, raw.buffer_length);
+
+    // every cut before the end of the data lands inside some field and has to be rejected
+    for(size_t length = 0; length < data_end; ++length)
+    {
+        rclcpp::SerializedMessage truncated(raw.buffer_length);
+        rcl_serialized_message_t &truncated_raw = truncated.get_rcl_serialized_message();
+        std::memcpy(truncated_raw.buffer, raw.buffer, length);
+        truncated_raw.buffer_length = length;
+
+        CloudView view;
+        EXPECT_FALSE(view.fromCdr(truncated)) << "buffer cut at " << length << " of " << raw.buffer_length << " bytes";
+    }
+}
+
+TEST(CloudView, FromCdrRejectsOversizedFieldCount)
+{
+    sensor_msgs::msg::PointCloud2 cloud = makeCloud("lidar_front");
+    cloud.fields.clear();
+    const auto serialized = serialize(cloud);
+    const rcl_serialized_message_t &raw = serialized.get_rcl_serialized_message();
+
+    // the field count follows the header and the dimensions, the empty field list leaves it at 0
+    CloudView view;
+    ASSERT_TRUE(view.fromCdr(serialized));
+    const size_t count_offset = 4 + 8 + 4 + ((cloud.header.frame_id.size() + 1 + 3) & ~size_t(3)) + 8;
+    uint32_t field_count;
+    std::memcpy(&field_count, raw.buffer + count_offset, sizeof(field_count));
+    ASSERT_EQ(field_count, 0u);
+
+    for(const uint32_t corrupt : {0xffffffffu, 0x10000000u, static_cast<uint32_t>(raw.buffer_length)})
+    {
+        rclcpp::SerializedMessage tampered(raw.buffer_length);
+        rcl_serialized_message_t &tampered_raw = tampered.get_rcl_serialized_message();
+        std::memcpy(tampered_raw.buffer, raw.buffer, raw.buffer_length);
+        tampered_raw.buffer_length = raw.buffer_length;
+        std::memcpy(tampered_raw.buffer + count_offset, &corrupt, sizeof(corrupt));
+
+        CloudView corrupted;
+        EXPECT_FALSE(corrupted.fromCdr(tampered)) << "field count " << corrupt;
+        EXPECT_LE(corrupted.fields.size(), raw.buffer_length);
+    }
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "laser_merger2/footprint_filter.h"
+
+namespace
+{
+// L shaped footprint, every corner on the 0.05 m raster
+const std::vector<double> rectilinear_polygon = {-0.5, -0.3, 0.6, -0.3, 0.6, 0.1, 0.2, 0.1, 0.2, 0.3, -0.5, 0.3};
+// bumper box sticking out in front, also on the raster
+const std::vector<double> boxes = {0.6, -0.2, 0.75, 0.2};
+// octagon-ish hull with slanted edges
+const std::vector<double> slanted_polygon = {-0.4, -0.2, -0.2, -0.4, 0.3, -0.4, 0.5, -0.1, 0.5, 0.15, 0.25, 0.4, -0.2, 0.4, -0.45, 0.1};
+
+double segmentDistance(double px, double py, double x0, double y0, double x1, double y1)
+{
+    const double dx = x1 - x0, dy = y1 - y0;
+    const double u = std::max(0.0, std::min(1.0, ((px - x0) * dx + (py - y0) * dy) / (dx * dx + dy * dy)));
+    return std::hypot(px - x0 - u * dx, py - y0 - u * dy);
+}
+
+// even-odd test in double plus inclusive boxes, the definition the filter implements
+bool insideReference(double x, double y, const std::vector<double> &polygon, const std::vector<double> &box_list)
+{
+    bool inside = false;
+    const size_t vertices = polygon.size() / 2;
+    for(size_t v = 0, w = vertices - 1; v < vertices; w = v++)
+    {
+        const double xv = polygon[2 * v], yv = polygon[2 * v + 1], xw = polygon[2 * w], yw = polygon[2 * w + 1];
+        if((yv > y) != (yw > y) && x < xv + (y - yv) * (xw - xv) / (yw - yv))
+            inside = !inside;
+    }
+    for(size_t b = 0; b < box_list.size(); b += 4)
+        inside |= x >= box_list[b] && x <= box_list[b + 2] && y >= box_list[b + 1] && y <= box_list[b + 3];
+    return inside;
+}
+
+// true when the point is too close to an outline for float rounding to decide the side
+bool nearOutline(double x, double y, const std::vector<double> &polygon, const std::vector<double> &box_list)
+{
+    const double margin = 1e-3;
+    const size_t vertices = polygon.size() / 2;
+    for(size_t v = 0, w = vertices - 1; v < vertices; w = v++)
+    {
+        if(segmentDistance(x, y, polygon[2 * w], polygon[2 * w + 1], polygon[2 * v], polygon[2 * v + 1]) < margin)
+            return true;
+    }
+    for(size_t b = 0; b < box_list.size(); b += 4)
+    {
+        const double x0 = box_list[b], y0 = box_list[b + 1], x1 = box_list[b + 2], y1 = box_list[b + 3];
+        if(segmentDistance(x, y, x0, y0, x1, y0) < margin || segmentDistance(x, y, x1, y0, x1, y1) < margin ||
+           segmentDistance(x, y, x1, y1, x0, y1) < margin || segmentDistance(x, y, x0, y1, x0, y0) < margin)
+            return true;
+    }
+    return false;
+}
+
+// points around the robot, denser near the footprint, with time and sensor columns to check compaction
+MergedCloud makeCloud(size_t count, const std::vector<double> &polygon, const std::vector<double> &box_list)
+{
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<float> near(-1.0f, 1.0f), far(-20.0f, 20.0f);
+
+    MergedCloud cloud;
+    cloud.has_time = true;
+    cloud.has_sensor_id = true;
+    while(cloud.size() < count)
+    {
+        const bool close = cloud.size() % 4 != 0;
+        const float x = close ? near(generator) : far(generator);
+        const float y = close ? near(generator) : far(generator);
+        if(nearOutline(x, y, polygon, box_list))
+            continue;
+        cloud.push_back(x, y, static_cast<float>(cloud.size() % 5), static_cast<float>(cloud.size()));
+        cloud.t.push_back(cloud.size() * 1e-5f);
+        cloud.sensor_id.push_back(static_cast<uint8_t>(cloud.size() % 3));
+    }
+    // non-finite points are not on the robot and are kept
+    cloud.push_back(NAN, 0.0f, 0.0f, -1.0f);
+    cloud.t.push_back(0.0f);
+    cloud.sensor_id.push_back(0);
+    return cloud;
+}
+
+void expectFiltered(FootprintFilter &filter, const std::vector<double> &polygon, const std::vector<double> &box_list)
+{
+    const MergedCloud input = makeCloud(5000, polygon, box_list);
+    for(const size_t workers : {1u, 3u})
+    {
+        SCOPED_TRACE(::testing::Message() << workers << " workers");
+        WorkerPool pool(workers);
+        MergedCloud output = input;
+        filter.filter(output, pool);
+
+        // the kept points, in their original order with every column moved along
+        size_t o = 0, removed = 0;
+        for(size_t i = 0; i < input.size(); ++i)
+        {
+            if(insideReference(input.x[i], input.y[i], polygon, box_list))
+            {
+                ++removed;
+                continue;
+            }
+            ASSERT_LT(o, output.size());
+            EXPECT_EQ(output.intensity[o], input.intensity[i]) << "input point " << i;
+            EXPECT_EQ(output.t[o], input.t[i]);
+            EXPECT_EQ(output.sensor_id[o], input.sensor_id[i]);
+            ++o;
+        }
+        EXPECT_EQ(o, output.size());
+        EXPECT_EQ(output.t.size(), output.size());
+        EXPECT_EQ(output.sensor_id.size(), output.size());
+        EXPECT_GT(removed, 20u);
+    }
+}
+}  // namespace
+
+TEST(FootprintFilter, RectilinearFootprintIsRasterized)
+{
+    FootprintFilter filter(rectilinear_polygon, boxes, 0.05);
+    ASSERT_FALSE(filter.empty());
+    EXPECT_TRUE(filter.rasterized());
+    expectFiltered(filter, rectilinear_polygon, boxes);
+}
+
+TEST(FootprintFilter, RectilinearFootprintWithoutResolutionUsesCrossingTest)
+{
+    FootprintFilter filter(rectilinear_polygon, boxes, 0.0);
+    EXPECT_FALSE(filter.rasterized());
+    expectFiltered(filter, rectilinear_polygon, boxes);
+}
+
+TEST(FootprintFilter, SlantedFootprintUsesCrossingTest)
+{
+    FootprintFilter filter(slanted_polygon, boxes, 0.05);
+    ASSERT_FALSE(filter.empty());
+    EXPECT_FALSE(filter.rasterized());
+    expectFiltered(filter, slanted_polygon, boxes);
+}
+
+TEST(FootprintFilter, BoxesOnly)
+{
+    FootprintFilter filter({}, boxes, 0.05);
+    ASSERT_FALSE(filter.empty());
+    EXPECT_TRUE(filter.rasterized());
+    expectFiltered(filter, {}, boxes);
+}
+
+TEST(FootprintFilter, DegenerateFootprintKeepsEverything)
+{
+    FootprintFilter filter({0.0, 0.0, 1.0, 1.0}, {}, 0.05);
+    EXPECT_TRUE(filter.empty());
+
+    WorkerPool pool(1);
+    MergedCloud cloud = makeCloud(100, {}, {});
+    const size_t count = cloud.size();
+    filter.filter(cloud, pool);
+    EXPECT_EQ(cloud.size(), count);
+}
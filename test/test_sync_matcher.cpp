@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "laser_merger2/sync_matcher.h"
+
+namespace
+{
+constexpr int64_t ms = 1000000;
+constexpr int64_t window = 20 * ms;
+
+// smallest spread over every combination of one stamp per sensor, and the newest oldest stamp among those
+void bruteForce(const std::vector<std::vector<int64_t>> &stamps, int64_t &best_spread, int64_t &best_oldest)
+{
+    best_spread = std::numeric_limits<int64_t>::max();
+    best_oldest = std::numeric_limits<int64_t>::min();
+    std::vector<size_t> index(stamps.size(), 0);
+    while(true)
+    {
+        int64_t oldest = std::numeric_limits<int64_t>::max(), newest = std::numeric_limits<int64_t>::min();
+        for(size_t s = 0; s < stamps.size(); ++s)
+        {
+            oldest = std::min(oldest, stamps[s][index[s]]);
+            newest = std::max(newest, stamps[s][index[s]]);
+        }
+        if(newest - oldest < best_spread || (newest - oldest == best_spread && oldest > best_oldest))
+        {
+            best_spread = newest - oldest;
+            best_oldest = oldest;
+        }
+
+        size_t s = 0;
+        while(s < stamps.size() && ++index[s] == stamps[s].size())
+            index[s++] = 0;
+        if(s == stamps.size())
+            return;
+    }
+}
+
+// Feeds streams of the given periods (ms, +-10% jitter) for duration ms in 1 ms steps, the stream at
+// silent_stream stops at silent_from. Returns the first time each stream was reported stalled, -1 if never.
+std::vector<int64_t> simulate(const std::vector<int64_t> &periods, int64_t duration, size_t silent_stream, int64_t silent_from)
+{
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int64_t> jitter(-10, 10);
+
+    std::vector<ArrivalMonitor> monitors(periods.size());
+    std::vector<int64_t> next(periods.size()), first_stall(periods.size(), -1);
+    for(size_t s = 0; s < periods.size(); ++s)
+    {
+        monitors[s].reset(0);
+        next[s] = periods[s] * ms;
+    }
+
+    for(int64_t now = 0; now <= duration * ms; now += ms)
+    {
+        int64_t slowest = 0;
+        for(size_t s = 0; s < periods.size(); ++s)
+        {
+            if(now >= next[s] && !(s == silent_stream && now >= silent_from * ms))
+            {
+                monitors[s].arrived(now);
+                next[s] = now + periods[s] * ms * (100 + jitter(generator)) / 100;
+            }
+            slowest = std::max(slowest, monitors[s].period());
+        }
+        for(size_t s = 0; s < periods.size(); ++s)
+        {
+            if(first_stall[s] < 0 && monitors[s].stalled(now, slowest, window))
+                first_stall[s] = now;
+        }
+    }
+    return first_stall;
+}
+}  // namespace
+
+TEST(MatchTightestSet, AgreesWithBruteForce)
+{
+    std::mt19937 generator(1);
+    for(int round = 0; round < 3000; ++round)
+    {
+        const size_t sensors = 1 + round % 5;
+        std::uniform_int_distribution<size_t> depth(1, 5);
+        // coarse stamps so that ties between sensors and between sets are common
+        std::uniform_int_distribution<int64_t> step(0, round % 2 ? 3 : 40);
+        std::vector<std::vector<int64_t>> stamps(sensors);
+        for(auto &queue : stamps)
+        {
+            int64_t stamp = step(generator);
+            for(size_t d = depth(generator); d > 0; --d)
+            {
+                queue.push_back(stamp);
+                stamp += step(generator);
+            }
+        }
+        const int64_t match_window = step(generator);
+
+        int64_t best_spread, best_oldest;
+        bruteForce(stamps, best_spread, best_oldest);
+
+        std::vector<size_t> picks;
+        const bool matched = matchTightestSet(stamps, match_window, picks);
+        ASSERT_EQ(matched, best_spread <= match_window) << "round " << round;
+        ASSERT_EQ(picks.size(), sensors) << "round " << round;
+
+        int64_t oldest = std::numeric_limits<int64_t>::max(), newest = std::numeric_limits<int64_t>::min();
+        for(size_t s = 0; s < sensors; ++s)
+        {
+            ASSERT_LT(picks[s], stamps[s].size());
+            oldest = std::min(oldest, stamps[s][picks[s]]);
+            newest = std::max(newest, stamps[s][picks[s]]);
+        }
+        EXPECT_EQ(newest - oldest, best_spread) << "round " << round;
+        // of equally tight sets the most recent one wins
+        EXPECT_EQ(oldest, best_oldest) << "round " << round;
+    }
+}
+
+TEST(MatchTightestSet, NoSensorOrEmptyQueue)
+{
+    std::vector<size_t> picks;
+    EXPECT_FALSE(matchTightestSet({}, window, picks));
+    EXPECT_FALSE(matchTightestSet({{1, 2}, {}}, window, picks));
+}
+
+TEST(ArrivalMonitor, SlowSensorNextToFastOneIsNotStalled)
+{
+    for(const int64_t fast : {10, 25})
+    {
+        const auto stalls = simulate({fast, 100, 50}, 5000, 99, 0);
+        for(size_t s = 0; s < stalls.size(); ++s)
+            EXPECT_EQ(stalls[s], -1) << "stream " << s << " with a " << fast << " ms neighbour";
+    }
+}
+
+TEST(ArrivalMonitor, StoppedSensorIsStalledAfterItsPeriods)
+{
+    const auto stalls = simulate({10, 100}, 5000, 1, 2000);
+    EXPECT_EQ(stalls[0], -1);
+    ASSERT_GE(stalls[1], 0);
+    // its last message came at most one period before it stopped
+    EXPECT_GT(stalls[1], (2000 - 110 + ArrivalMonitor::stall_periods * 90) * ms);
+    EXPECT_LE(stalls[1], 2000 * ms + ArrivalMonitor::stall_periods * 110 * ms + window);
+}
+
+TEST(ArrivalMonitor, SilentSinceSubscriptionUsesSlowestKnownPeriod)
+{
+    ArrivalMonitor monitor;
+    monitor.reset(0);
+    EXPECT_FALSE(monitor.stalled(10000 * ms, 0, window));
+    EXPECT_FALSE(monitor.stalled(ArrivalMonitor::startup_grace, 100 * ms, window));
+    EXPECT_TRUE(monitor.stalled(ArrivalMonitor::startup_grace + 1, 100 * ms, window));
+    EXPECT_FALSE(monitor.stalled(1500 * ms + window, 500 * ms, window));
+    EXPECT_TRUE(monitor.stalled(1500 * ms + window + 1, 500 * ms, window));
+}
+
+TEST(ArrivalMonitor, GapDoesNotStretchThePeriod)
+{
+    ArrivalMonitor monitor;
+    monitor.reset(0);
+    for(int64_t now = 0; now <= 1000 * ms; now += 100 * ms)
+        monitor.arrived(now);
+    EXPECT_EQ(monitor.period(), 100 * ms);
+
+    // back after a five second outage, the next silence is judged on the 100 ms period again
+    monitor.arrived(6000 * ms);
+    EXPECT_EQ(monitor.period(), 100 * ms);
+    EXPECT_TRUE(monitor.stalled(6400 * ms, 0, window));
+}
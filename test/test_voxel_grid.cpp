@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "laser_merger2/voxel_grid.h"
+
+namespace
+{
+typedef std::tuple<int64_t, int64_t, int64_t> Leaf;
+
+struct ReferenceLeaf
+{
+    size_t first;
+    size_t count = 0;
+    double x = 0.0, y = 0.0, z = 0.0, intensity = 0.0, t = 0.0;
+    bool seen = false;
+};
+
+Leaf leafOf(float x, float y, float z, float leaf)
+{
+    return Leaf(static_cast<int64_t>(std::floor(x / leaf)), static_cast<int64_t>(std::floor(y / leaf)),
+                static_cast<int64_t>(std::floor(z / leaf)));
+}
+
+// Points jittered around the centres of a few hundred leaves, so every centroid stays well inside its leaf,
+// plus non-finite and out of key range points the filter has to drop
+MergedCloud makeCloud(size_t count, float leaf, unsigned seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> cell(-12, 12);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    MergedCloud cloud;
+    cloud.has_time = true;
+    cloud.has_sensor_id = true;
+    for(size_t i = 0; i < count; ++i)
+    {
+        const float x = (cell(generator) + 0.5f + jitter(generator)) * leaf;
+        const float y = (cell(generator) + 0.5f + jitter(generator)) * leaf;
+        const float z = (cell(generator) / 4 + 0.5f + jitter(generator)) * leaf;
+        cloud.push_back(x, y, z, static_cast<float>(i % 100));
+        cloud.t.push_back(i * 1e-6f);
+        cloud.sensor_id.push_back(static_cast<uint8_t>(i % 7));
+    }
+    for(const float bad : {NAN, INFINITY, 1e12f})
+    {
+        cloud.push_back(bad, 0.0f, 0.0f, 1.0f);
+        cloud.t.push_back(0.0f);
+        cloud.sensor_id.push_back(0);
+    }
+    return cloud;
+}
+
+void expectMatchesReference(const MergedCloud &input, const MergedCloud &output, float leaf, VoxelGrid::Policy policy)
+{
+    std::map<Leaf, ReferenceLeaf> reference;
+    for(size_t i = 0; i < input.size(); ++i)
+    {
+        if(!std::isfinite(input.x[i]) || std::abs(input.x[i]) > 1e6f)
+            continue;
+        auto inserted = reference.emplace(leafOf(input.x[i], input.y[i], input.z[i], leaf), ReferenceLeaf{i});
+        ReferenceLeaf &cell = inserted.first->second;
+        ++cell.count;
+        cell.x += input.x[i];
+        cell.y += input.y[i];
+        cell.z += input.z[i];
+        cell.intensity += input.intensity[i];
+        cell.t += input.t[i];
+    }
+
+    ASSERT_EQ(output.size(), reference.size());
+    ASSERT_EQ(output.t.size(), output.size());
+    ASSERT_EQ(output.sensor_id.size(), output.size());
+    for(size_t o = 0; o < output.size(); ++o)
+    {
+        auto found = reference.find(leafOf(output.x[o], output.y[o], output.z[o], leaf));
+        ASSERT_NE(found, reference.end()) << "point " << o << " lies in no input leaf";
+        ReferenceLeaf &cell = found->second;
+        EXPECT_FALSE(cell.seen) << "leaf emitted twice";
+        cell.seen = true;
+
+        // both policies keep the sensor of the first point in merge order
+        EXPECT_EQ(output.sensor_id[o], input.sensor_id[cell.first]);
+        if(policy == VoxelGrid::Policy::First)
+        {
+            EXPECT_EQ(output.x[o], input.x[cell.first]);
+            EXPECT_EQ(output.y[o], input.y[cell.first]);
+            EXPECT_EQ(output.z[o], input.z[cell.first]);
+            EXPECT_EQ(output.intensity[o], input.intensity[cell.first]);
+            EXPECT_EQ(output.t[o], input.t[cell.first]);
+            continue;
+        }
+        EXPECT_NEAR(output.x[o], cell.x / cell.count, 1e-5);
+        EXPECT_NEAR(output.y[o], cell.y / cell.count, 1e-5);
+        EXPECT_NEAR(output.z[o], cell.z / cell.count, 1e-5);
+        EXPECT_NEAR(output.intensity[o], cell.intensity / cell.count, 1e-3);
+        EXPECT_NEAR(output.t[o], cell.t / cell.count, 1e-6);
+    }
+}
+}  // namespace
+
+TEST(VoxelGrid, MatchesMapReference)
+{
+    const float leaf = 0.1f;
+    for(const auto policy : {VoxelGrid::Policy::Centroid, VoxelGrid::Policy::First})
+    {
+        for(const size_t workers : {1u, 2u, 3u, 4u})
+        {
+            WorkerPool pool(workers);
+            VoxelGrid grid(leaf, policy);
+            // the same grid over growing and shrinking clouds, tables are reused across cycles
+            for(const size_t count : {5000u, 40000u, 300u, 40000u})
+            {
+                SCOPED_TRACE(::testing::Message() << "policy " << static_cast<int>(policy) << ", "
+                                                  << workers << " workers, " << count << " points");
+                const MergedCloud input = makeCloud(count, leaf, static_cast<unsigned>(count + workers));
+                MergedCloud output = input;
+                grid.filter(output, pool);
+                expectMatchesReference(input, output, leaf, policy);
+            }
+        }
+    }
+}
+
+TEST(VoxelGrid, SetLeafSizeTakesEffect)
+{
+    WorkerPool pool(2);
+    VoxelGrid grid(0.1f, VoxelGrid::Policy::Centroid);
+    grid.setLeafSize(0.4f);
+
+    const MergedCloud input = makeCloud(20000, 0.4f, 11);
+    MergedCloud output = input;
+    grid.filter(output, pool);
+    expectMatchesReference(input, output, 0.4f, VoxelGrid::Policy::Centroid);
+}
+
+TEST(VoxelGrid, EmptyCloud)
+{
+    WorkerPool pool(2);
+    VoxelGrid grid(0.1f, VoxelGrid::Policy::Centroid);
+    MergedCloud cloud;
+    grid.filter(cloud, pool);
+    EXPECT_TRUE(cloud.empty());
+}
+
+TEST(VoxelGrid, ReservedGridMatchesReference)
+{
+    WorkerPool pool(3);
+    VoxelGrid grid(0.1f, VoxelGrid::Policy::Centroid);
+    grid.reserve(50000, pool.size());
+
+    const MergedCloud input = makeCloud(30000, 0.1f, 7);
+    MergedCloud output = input;
+    grid.filter(output, pool);
+    expectMatchesReference(input, output, 0.1f, VoxelGrid::Policy::Centroid);
+}
@@ -0,0 +1,92 @@
+// Times the voxel grid stage against pcl::VoxelGrid on the same synthetic merged cloud.
+// Not run by ctest: ./voxel_grid_benchmark [points] [leaf_size] [workers]
+#include <laser_merger2/voxel_grid.h>
+
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/point_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// points spread like several scans and a 3D lidar around the robot
+MergedCloud makeCloud(size_t count)
+{
+    MergedCloud cloud;
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> angle(-M_PI, M_PI), range(0.5f, 30.0f), height(-1.0f, 3.0f);
+    for(size_t i = 0; i < count; ++i)
+    {
+        const float a = angle(generator), r = range(generator);
+        cloud.push_back(r * std::cos(a), r * std::sin(a), height(generator), 10.0f);
+    }
+    return cloud;
+}
+
+template<class F>
+double medianMs(F &&run, int repeats)
+{
+    std::vector<double> times;
+    for(int k = 0; k < repeats; ++k)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        run();
+        times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    const size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 120000;
+    const float leaf = argc > 2 ? std::strtof(argv[2], nullptr) : 0.05f;
+    // more workers than cores measures time slicing, not scaling
+    const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const size_t workers = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : cores;
+    const int repeats = 30;
+    const MergedCloud cloud = makeCloud(count);
+
+    WorkerPool pool(workers);
+    VoxelGrid grid(leaf, VoxelGrid::Policy::Centroid);
+    size_t leaves = 0;
+    const double ours = medianMs([&]()
+        {
+            MergedCloud points = cloud;
+            grid.filter(points, pool);
+            leaves = points.size();
+        }, repeats);
+
+    pcl::PointCloud<pcl::PointXYZI>::Ptr input(new pcl::PointCloud<pcl::PointXYZI>);
+    for(size_t i = 0; i < cloud.size(); ++i)
+    {
+        pcl::PointXYZI point;
+        point.x = cloud.x[i];
+        point.y = cloud.y[i];
+        point.z = cloud.z[i];
+        point.intensity = cloud.intensity[i];
+        input->push_back(point);
+    }
+    pcl::VoxelGrid<pcl::PointXYZI> reference;
+    reference.setLeafSize(leaf, leaf, leaf);
+    pcl::PointCloud<pcl::PointXYZI> output;
+    const double pcl_ms = medianMs([&]()
+        {
+            reference.setInputCloud(input);
+            reference.filter(output);
+        }, repeats);
+
+    // the copy into the PointXYZI cloud is left out of the PCL time, the copy of the merged buffer is not
+    std::printf("%zu points, leaf %.3f m, %zu workers on %zu cores\n", count, leaf, workers, cores);
+    std::printf("VoxelGrid       %8.2f ms  %zu leaves\n", ours, leaves);
+    std::printf("pcl::VoxelGrid  %8.2f ms  %zu leaves\n", pcl_ms, output.size());
+    return 0;
+}